@@ -1,106 +1,577 @@
 #include "redis.h"
+#include "redisScan.h"
 
 #include <iostream>
+#include <algorithm>
+#include <charconv>
 
 #include <sys/types.h>          /* See NOTES */
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include <cstdlib>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 using namespace std;
 
 namespace redis {
+
+// size of the initial receive buffer, and minimum size of each read(2).
+static const size_t RECV_BUFFER_SIZE = 16384;
+
+// how far pipelines run ahead of their replies by default.
+static const size_t WINDOW_COMMANDS = 4096;
+static const size_t WINDOW_BYTES = 1024 * 1024;
+
 Client::Client() :
+	m_fd(-1),
 	m_multi(false),
-	m_pipeline(false) {
+	m_pipeline(false),
+	m_window_commands(WINDOW_COMMANDS),
+	m_window_bytes(WINDOW_BYTES),
+	m_sent(0),
+	m_acked(0),
+	m_pumping(false),
+	m_rbuf(RECV_BUFFER_SIZE),
+	m_rpos(0),
+	m_rlen(0),
+	m_rgen(0),
+	m_pins(0),
+	m_loop(0),
+	m_framer(false),
+	m_drop(false),
+	m_wpos(0),
+	m_port(0),
+	m_broken(false),
+	m_db(0),
+	m_connect_timeout(0),
+	m_io_timeout(0),
+	m_retry_attempts(5),
+	m_retry_min_delay(10),
+	m_retry_max_delay(1000),
+	m_rng((unsigned long)time(0) ^ (unsigned long)this),
+	m_shared(false),
+	m_flushing(false) {
+}
+
+/**
+ * Leaves the event loop the client is attached to, and closes the connection.
+ */
+Client::~Client() {
+
+	if(m_loop) {
+		m_loop->remove(*this);
+	}
+	disconnect();
 }
 
 bool 
 Client::connect(std::string host, short port) {
-	int fd = socket(AF_INET, SOCK_STREAM, 0);
-	if(!fd) {
+	disconnect();
+	m_host = host;
+	m_port = port;
+	m_path.clear();
+	m_password.clear();
+	m_db = 0;
+
+	return open();
+}
+
+/**
+ * Connects to a local server through a Unix domain socket.
+ */
+bool
+Client::connect_unix(std::string path) {
+	disconnect();
+	m_host.clear();
+	m_path = path;
+	m_password.clear();
+	m_db = 0;
+
+	return open();
+}
+
+/**
+ * Deadlines in milliseconds for connecting, and for each read or write.
+ * A read or write that times out breaks the connection. 0 means none.
+ */
+void
+Client::timeout(int connect_ms, int io_ms) {
+	m_connect_timeout = connect_ms;
+	m_io_timeout = io_ms;
+
+	if(m_fd != -1) {
+		set_io_timeout();
+	}
+}
+
+/**
+ * How many times to try to reopen a broken connection, waiting from
+ * min_delay_ms to max_delay_ms (doubling, with jitter) between attempts.
+ */
+void
+Client::retry(int attempts, int min_delay_ms, int max_delay_ms) {
+	m_retry_attempts = attempts;
+	m_retry_min_delay = min_delay_ms;
+	m_retry_max_delay = max_delay_ms;
+}
+
+/**
+ * Limits how far pipelines run ahead of their replies: at most `commands`
+ * commands and `bytes` bytes are sent before their replies are read, one
+ * command being sent in any case. Long pipelines are sent as they are
+ * being queued, so that neither side buffers the whole of them.
+ */
+void
+Client::window(size_t commands, size_t bytes) {
+	m_window_commands = commands ? commands : 1;
+	m_window_bytes = bytes ? bytes : 1;
+}
+
+/**
+ * connect(2) giving up after timeout ms, if positive.
+ */
+static bool
+connect_timeout(int fd, const struct sockaddr *addr, socklen_t len, int timeout) {
+
+	if(timeout <= 0) {
+		return ::connect(fd, addr, len) == 0;
+	}
+
+	int flags = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+	int ret = ::connect(fd, addr, len);
+	if(ret == -1 && errno == EINPROGRESS) {
+		struct pollfd p;
+		p.fd = fd;
+		p.events = POLLOUT;
+
+		if(poll(&p, 1, timeout) == 1) {
+			int err = 0;
+			socklen_t sz = sizeof(err);
+			if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &sz) == 0 && err == 0) {
+				ret = 0;
+			}
+		}
+	}
+
+	fcntl(fd, F_SETFL, flags);
+	return ret == 0;
+}
+
+/**
+ * Opens a socket to the current address.
+ */
+bool
+Client::open() {
+
+	struct sockaddr_storage addr;
+	socklen_t len;
+	memset(&addr, 0, sizeof(addr));
+
+	if(!m_path.empty()) {
+		struct sockaddr_un *un = (struct sockaddr_un*)&addr;
+		if(m_path.size() >= sizeof(un->sun_path)) {
+			return false;
+		}
+		un->sun_family = AF_UNIX;
+		memcpy(un->sun_path, m_path.c_str(), m_path.size());
+		len = sizeof(*un);
+	} else {
+		struct sockaddr_in *in = (struct sockaddr_in*)&addr;
+		in->sin_family = AF_INET;
+		in->sin_port = htons(m_port);
+		inet_pton(AF_INET, m_host.c_str(), &in->sin_addr);
+		len = sizeof(*in);
+	}
+
+	int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd == -1) {
 		return false;
 	}
-	struct sockaddr_in addr;
-	memset(&addr, 0, sizeof(addr)); // std::fill(_n) ?
 
-	// setup socket
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(port);
-	inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+	if(addr.ss_family == AF_INET) { // don't hold back small commands.
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+	}
 
-	// connect.
-	int ret = ::connect(fd, (struct sockaddr*)&addr, sizeof(addr));
-	if(ret == 0) {
-		m_fd = fd;
-		return true;
+	if(!connect_timeout(fd, (struct sockaddr*)&addr, len, m_connect_timeout)) {
+		close(fd);
+		return false;
 	}
 
+	m_fd = fd;
+	m_broken = false;
+	m_rpos = m_rlen = 0;
+	set_io_timeout();
+	return true;
+}
+
+void
+Client::set_io_timeout() {
+
+	struct timeval tv;
+	tv.tv_sec = m_io_timeout / 1000;
+	tv.tv_usec = (m_io_timeout % 1000) * 1000;
+
+	setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * Closes the current socket and opens a new one, backing off between
+ * attempts. The AUTH and SELECT state of the old connection is restored.
+ */
+bool
+Client::reopen() {
+
+	if(m_host.empty() && m_path.empty()) {
+		return false;
+	}
+
+	long delay = m_retry_min_delay;
+	for(int i = 0; i < m_retry_attempts; ++i) {
+		if(m_fd != -1) {
+			close(m_fd);
+			m_fd = -1;
+		}
+
+		if(i) { // sleep between delay/2 and delay.
+			long half = delay / 2;
+			long ms = half + (half ? (long)(m_rng() % (half + 1)) : 0);
+			usleep(ms * 1000);
+			delay = min(2 * delay, (long)m_retry_max_delay);
+		}
+
+		if(open() && restore()) {
+			return true;
+		}
+	}
 	return false;
 }
 
+bool
+Client::restore() {
+
+	if(!m_password.empty()) {
+		Command cmd("AUTH");
+		cmd << m_password;
+		if(!run(cmd) || !read_status_code().get<bool>()) {
+			return false;
+		}
+	}
+	if(m_db) {
+		Command cmd("SELECT");
+		cmd << (long)m_db;
+		if(!run(cmd) || !read_status_code().get<bool>()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Whether the socket is open and no read or write has failed on it.
+ */
+bool
+Client::connected() const {
+	return m_fd != -1 && !m_broken;
+}
+
 void
+Client::disconnect() {
+
+	if(m_fd != -1) {
+		close(m_fd);
+		m_fd = -1;
+	}
+
+	// forget about anything that was in flight.
+	m_multi = false;
+	m_pipeline = false;
+	m_cmd.clear();
+	m_readers.clear();
+	m_mget_keys.clear();
+	m_ends.clear();
+	m_replies.clear();
+	m_arena.reset();
+	m_sent = m_acked = 0;
+	if(!m_loop) {
+		m_pending.clear();
+	}
+	if(m_pins) {
+		retire();
+	}
+	m_rpos = m_rlen = 0;
+	m_wpos = 0;
+}
+
+/**
+ * Opens a new connection to the last address given to connect() or
+ * connect_unix(), dropping any transaction or pipeline in progress.
+ */
+bool
+Client::reconnect() {
+
+	if(m_loop) {
+		return false;
+	}
+	disconnect();
+	return reopen();
+}
+
+bool
 Client::run(Command &c) {
 
-	Buffer cmd = c.get();
+	// one iovec, plus two per large argument.
+	struct iovec small[8];
+	size_t n = c.get(small, 8);
+	if(n <= 8) {
+		return send(small, n);
+	}
+
+	vector<struct iovec> iov(n);
+	c.get(&iov[0], n);
+	return send(&iov[0], n);
+}
+
+/**
+ * Writes out a list of iovecs, resuming after partial writes.
+ * The iovecs are modified in the process.
+ */
+bool
+Client::send(struct iovec *iov, size_t count, int flags) {
+
+	while(count) {
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count < IOV_MAX ? count : IOV_MAX;
+
+		ssize_t sent = sendmsg(m_fd, &msg, MSG_NOSIGNAL | flags);
+		if(sent < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			m_broken = true;
+			return false;
+		}
 
-	int ret = write(m_fd, &cmd[0], cmd.size());
-	(void)ret; // TODO: check return value.
+		// skip what has been written.
+		while(count && (size_t)sent >= iov->iov_len) {
+			sent -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if(count) {
+			iov->iov_base = (char*)iov->iov_base + sent;
+			iov->iov_len -= sent;
+		}
+	}
+	return true;
 }
 
+/**
+ * Sends a command and reads its reply, or queues it depending on the mode.
+ * MGET replies need their keys, which are queued along with the reader.
+ */
 Response
-Client::run(Command &c, ResponseReader fun) {
+Client::run(Command &c, ResponseReader fun, const List *keys) {
 
-	if(m_pipeline) { // just enqueue the request
-		m_readers.push_back(fun); // remember the reading fun.
+	if(m_shared) {
+		return run_shared(c, fun, keys);
+	}
 
-		// concat command
-		Buffer cmd = c.get();
-		m_cmd.insert(m_cmd.end(), cmd.begin(), cmd.end());
+	if(m_loop) { // asynchronous: queue the command, the loop sends it.
+		size_t queued = m_cmd.size();
+		bool idle = (m_wpos == queued);
+		c.append_to(m_cmd);
+		bool skip = m_drop;
+		handled(fun);
+
+		if(idle && !m_loop->watch(*this, true)) { // never sent, drop it.
+			m_pending.pop_back();
+			m_cmd.resize(queued);
+			return Response(REDIS_ERR);
+		}
+		if(keys && !skip) {
+			m_mget_keys.push_back(*keys);
+		}
 		return Response(REDIS_QUEUED);
 	}
-	// otherwise, exec
-	run(c);
 
-	if(m_multi) { // either queued, read confirmation
+	if(m_pipeline) { // enqueue the request, it is sent with the next window.
+		if(keys && !m_drop) {
+			m_mget_keys.push_back(*keys);
+		}
+		c.append_to(m_cmd);
+		pipelined(fun);
+		return Response(REDIS_QUEUED);
+	}
+	m_callback = Callback();
+	m_drop = false;
+
+	if(m_multi) { // buffered, the whole transaction is sent by exec().
+		if(keys) {
+			m_mget_keys.push_back(*keys);
+		}
+		c.append_to(m_cmd);
 		m_readers.push_back(fun);
-		return read_queued();
-	} else { // or read normal reply.
-		return (this->*fun)();
+		return Response(REDIS_QUEUED);
+	}
+
+	// otherwise, exec. A broken connection is reopened and a command that
+	// could not be sent is sent again.
+	if(!connected() && !reopen()) {
+		return Response(REDIS_ERR);
+	}
+	if(!run(c) && (!reopen() || !run(c))) {
+		return Response(REDIS_ERR);
+	}
+	if(keys) {
+		m_mget_keys.push_back(*keys);
 	}
+	return (this->*fun)();
+}
+
+/**
+ * Lets several threads use this client at once. Commands issued while
+ * another thread is waiting for its replies are queued, then sent in a
+ * single write by the first of them to get hold of the connection, which
+ * reads all their replies and hands them back in order.
+ */
+bool
+Client::share() {
+	if(m_multi || m_pipeline || m_loop) {
+		return false;
+	}
+	m_shared = true;
+	return true;
 }
 
+Response
+Client::run_shared(Command &c, ResponseReader fun, const List *keys) {
+
+	Buffer cmd;
+	c.append_to(cmd);
+	SharedReply reply(fun);
+
+	unique_lock<mutex> lock(m_shared_lock);
+	m_cmd.insert(m_cmd.end(), cmd.begin(), cmd.end());
+	m_shared_replies.push_back(&reply);
+	if(keys) {
+		m_shared_keys.push_back(*keys);
+	}
+
+	while(!reply.done) {
+		if(m_flushing) { // somebody else is on the socket, wait for them.
+			m_shared_cond.wait(lock);
+			continue;
+		}
+
+		// take everything queued so far, including our command. The batch
+		// buffers are only touched by the thread holding m_flushing.
+		m_flushing = true;
+		m_batch.clear();
+		m_batch.swap(m_cmd);
+		m_batch_replies.clear();
+		m_batch_replies.swap(m_shared_replies);
+		m_mget_keys.swap(m_shared_keys);
+		m_shared_keys.clear();
+		lock.unlock();
+
+		struct iovec iov;
+		iov.iov_base = &m_batch[0];
+		iov.iov_len = m_batch.size();
+		bool sent = (connected() || reopen()) && send(&iov, 1);
+
+		vector<SharedReply*>::iterator r;
+		for(r = m_batch_replies.begin(); r != m_batch_replies.end(); r++) {
+			(*r)->resp = sent ? (this->*(*r)->fun)() : Response(REDIS_ERR);
+		}
+		m_mget_keys.clear();
+
+		lock.lock();
+		for(r = m_batch_replies.begin(); r != m_batch_replies.end(); r++) {
+			(*r)->done = true;
+		}
+		m_flushing = false;
+		m_shared_cond.notify_all();
+	}
+	return reply.resp;
+}
+
+/**
+ * Drops a transaction, which was never sent, or a pipeline. Replies still
+ * expected for a pipeline are not waited for: the connection is closed.
+ */
 Response
 Client::discard() {
-	m_multi = false;
-	m_pipeline = false;
-	m_cmd.clear();
-	m_readers.clear();
+	if(m_multi || m_pipeline) {
+		if(m_pipeline && m_sent) {
+			disconnect();
+		}
+		m_multi = false;
+		m_pipeline = false;
+		m_cmd.clear();
+		m_wpos = 0;
+		m_readers.clear();
+		m_mget_keys.clear();
+		m_pending.clear();
+		m_ends.clear();
+		m_replies.clear();
+		m_arena.reset();
+
+		Response ret(REDIS_BOOL);
+		ret.set(true);
+		return ret;
+	}
 
 	Command cmd("DISCARD");
 	return run(cmd, &Client::read_status_code);
 }
 
 
+/**
+ * Starts a transaction. Its commands are buffered, and sent along with
+ * MULTI and EXEC in a single write by exec().
+ */
 Response
 Client::multi() {
-	if(m_multi || m_pipeline) {
+	if(m_multi || m_pipeline || m_loop || m_shared) {
 		return Response(REDIS_ERR);
 	}
 
+	m_cmd.clear();
 	Command cmd("MULTI");
-	Response ret = run(cmd, &Client::read_status_code);
+	cmd.append_to(m_cmd);
 	m_multi = true;
+
+	Response ret(REDIS_BOOL);
+	ret.set(true);
 	return ret;
 }
 
 bool
 Client::pipeline() {
-	if(m_multi || m_pipeline) {
+	if(m_multi || m_pipeline || m_loop || m_shared) {
 		return false;
 	}
 	m_pipeline = true;
+	m_framer.reset();
 	return true;
 }
 
@@ -114,104 +585,844 @@ Client::exec() {
 	return vector<Response>();
 }
 
+/**
+ * Sends sz bytes of a file from offset, letting the kernel move them to
+ * the socket. Pipes are spliced, other files are copied as a last resort.
+ */
+bool
+Client::send_file(int fd, off_t offset, size_t sz) {
+
+	bool copy = false;
+	while(sz) {
+		ssize_t n;
+		if(!copy) {
+			n = sendfile(m_fd, fd, &offset, sz);
+			if(n == -1 && (errno == EINVAL || errno == ESPIPE)) {
+				n = splice(fd, 0, m_fd, 0, sz, SPLICE_F_MORE);
+				copy = (n == -1 && errno == EINVAL);
+			}
+		}
+		if(copy) {
+			char chunk[RECV_BUFFER_SIZE];
+			n = pread(fd, chunk, min(sz, sizeof(chunk)), offset);
+			if(n == -1 && errno == ESPIPE) {
+				n = read(fd, chunk, min(sz, sizeof(chunk)));
+			}
+			struct iovec iov;
+			iov.iov_base = chunk;
+			iov.iov_len = n;
+			if(n > 0 && !send(&iov, 1, MSG_MORE)) {
+				return false;
+			}
+			offset += n > 0 ? n : 0;
+		}
+
+		if(n == -1 && errno == EINTR) {
+			continue;
+		}
+		if(n <= 0) { // the file is shorter than announced: give up.
+			m_broken = true;
+			return false;
+		}
+		sz -= n;
+	}
+	return true;
+}
+
+/**
+ * Sends a command followed by a payload that is not copied: either sz
+ * bytes from memory (such as a mapped file), or read from fd at offset.
+ * The file position of fd is left where it was, even on a retry.
+ * Only for blocking clients outside of MULTI and pipelines.
+ */
+Response
+Client::run_payload(Command &c, const void *data, int fd, off_t offset, size_t sz, ResponseReader fun) {
+
+	m_callback = Callback();
+	m_drop = false;
+	if(m_multi || m_pipeline || m_loop || m_shared) {
+		return Response(REDIS_ERR);
+	}
+
+	static char crlf[] = "\r\n";
+	vector<struct iovec> iov(c.get(0, 0, sz));
+	c.get(&iov[0], iov.size(), sz);
+
+	for(int attempt = 0; attempt < 2; ++attempt) {
+		if(!connected() && !reopen()) {
+			return Response(REDIS_ERR);
+		}
+
+		bool sent;
+		if(data) {
+			vector<struct iovec> all(iov);
+			all.resize(all.size() + 2);
+			all[all.size() - 2].iov_base = (void*)data;
+			all[all.size() - 2].iov_len = sz;
+			all[all.size() - 1].iov_base = crlf;
+			all[all.size() - 1].iov_len = 2;
+			sent = send(&all[0], all.size());
+		} else {
+			vector<struct iovec> head(iov);
+			struct iovec end;
+			end.iov_base = crlf;
+			end.iov_len = 2;
+			sent = send(&head[0], head.size(), MSG_MORE) &&
+				send_file(fd, offset, sz) && send(&end, 1);
+		}
+		if(sent) {
+			return (this->*fun)();
+		}
+		struct stat st;
+		if(!data && (fstat(fd, &st) == -1 || !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)))) {
+			break; // pipes can't be replayed.
+		}
+		disconnect(); // retry once on a new connection
+	}
+	return Response(REDIS_ERR);
+}
+
+/**
+ * Sends a command whose reply the caller reads directly. Only for blocking
+ * clients outside of MULTI and pipelines.
+ */
+bool
+Client::run_direct(Command &c) {
+
+	m_callback = Callback();
+	m_drop = false;
+	if(m_multi || m_pipeline || m_loop || m_shared) {
+		return false;
+	}
+
+	if(!connected() && !reopen()) {
+		return false;
+	}
+	return run(c) || (reopen() && run(c));
+}
+
+/**
+ * Sends a command and reads its reply as a view.
+ */
+bool
+Client::run(Command &c, ReplyView &out) {
+
+	out.release();
+	return run_direct(c) && read_view(out);
+}
+
+/**
+ * Runs a prepared command with the values of its params, in any mode.
+ */
+Response
+Client::execute(const PreparedCommand &p, const List &values) {
+
+	if(values.size() != p.params()) {
+		m_callback = Callback();
+		m_drop = false;
+		return Response(REDIS_ERR);
+	}
+	Command cmd = p.bind(values);
+	return run(cmd, &Client::read_any);
+}
+
+// bytes of prepared commands encoded before they are sent in a batch.
+static const size_t BATCH_BYTES = 256 * 1024;
+
+/**
+ * Runs a prepared command once per row of values. Blocking clients encode
+ * them in chunks straight into the pipeline buffer, each chunk being sent
+ * at once before its replies are read. In a pipeline they are queued, and
+ * otherwise executed one by one.
+ */
 vector<Response>
-Client::exec_multi() {
-	vector<Response> ret;
+Client::execute(const PreparedCommand &p, const vector<List> &batch) {
 
-	Command cmd("EXEC");
-	run(cmd);
+	vector<Response> ret(batch.size(), Response(REDIS_ERR));
+	m_callback = Callback();
+	m_drop = false;
 
-	// this will contain the number of responses.
-	std::string str = getline();
-	if(str[0] != '*' || ::atol(&str[1]) != (long)m_readers.size()) {
-		return vector<Response>(); // fail.
+	if(m_multi || m_loop || m_shared) {
+		for(size_t i = 0; i < batch.size(); ++i) {
+			ret[i] = execute(p, batch[i]);
+		}
+		return ret;
 	}
 
-	// read back each response
-	vector<ResponseReader>::const_iterator funptr;
-	for(funptr = m_readers.begin(); funptr != m_readers.end(); funptr++) {
-		Response resp = (this->**funptr)();
-		ret.push_back(resp);
+	if(m_pipeline) {
+		for(size_t i = 0; i < batch.size(); ++i) {
+			if(batch[i].size() == p.params()) {
+				p.append_to(m_cmd, batch[i]);
+				pipelined(&Client::read_any);
+				ret[i] = Response(REDIS_QUEUED);
+			}
+		}
+		return ret;
 	}
 
-	// cleanup
+	if(!connected() && !reopen()) {
+		return ret;
+	}
+	vector<size_t> rows;
+	m_arena = make_shared<pmr::monotonic_buffer_resource>();
+	for(size_t i = 0; i < batch.size(); ) {
+		m_cmd.clear();
+		rows.clear();
+		for(; i < batch.size() && m_cmd.size() < BATCH_BYTES; ++i) {
+			if(batch[i].size() == p.params()) {
+				p.append_to(m_cmd, batch[i]);
+				rows.push_back(i);
+			}
+		}
+		if(rows.empty()) {
+			break;
+		}
+
+		struct iovec iov;
+		iov.iov_base = &m_cmd[0];
+		iov.iov_len = m_cmd.size();
+		bool sent = send(&iov, 1);
+		m_cmd.clear();
+		if(!sent) { // part of it may have run, don't send it again.
+			break;
+		}
+
+		for(size_t r = 0; r < rows.size(); ++r) {
+			ret[rows[r]] = read_any();
+		}
+	}
+	m_arena.reset();
+	return ret;
+}
+
+/**
+ * Sets the completion callback of the next command, for clients attached
+ * to an EventLoop and in pipelines: c.on_reply(cb).get("key");
+ * A pipelined reply is passed to its callback as soon as it is read, and
+ * exec() only returns the replies of commands without a callback.
+ */
+Client &
+Client::on_reply(Callback cb) {
+	m_callback = std::move(cb);
+	m_drop = false;
+	return *this;
+}
+
+/**
+ * Skips the reply of the next command without decoding it, in pipelines
+ * and on an EventLoop: c.drop().set("key", "val");
+ */
+Client &
+Client::drop() {
+	m_callback = Callback();
+	m_drop = true;
+	return *this;
+}
+
+static void
+ignore(Response &) {
+}
+
+/**
+ * Queues the reader and callback of a command whose reply comes later.
+ * Dropped replies are skipped and given to a callback that ignores them.
+ */
+void
+Client::handled(ResponseReader fun) {
+
+	if(m_drop) {
+		m_pending.push_back(make_pair(&Client::skip_reply, Callback(ignore)));
+	} else {
+		m_pending.push_back(make_pair(fun, std::move(m_callback)));
+	}
+	m_callback = Callback();
+	m_drop = false;
+}
+
+/**
+ * Scans the first reply in buf, resuming at pos with remaining elements
+ * left to see. Returns true once it is complete, pos being its size.
+ */
+static bool
+scan_reply(const char *buf, size_t len, size_t &pos, long &remaining) {
+
+	while(remaining) {
+		if(pos >= len) {
+			return false;
+		}
+		const char *nl = find_lf(buf + pos, len - pos);
+		if(!nl) {
+			return false;
+		}
+		char t = buf[pos];
+		long n = parse_long(buf + pos + 1, nl);
+		pos = nl + 1 - buf;
+		remaining--;
+
+		if(t == '$' && n >= 0) { // payload and its CRLF
+			pos += n + 2;
+		} else if(t == '*' && n > 0) {
+			remaining += n;
+		}
+	}
+	return pos <= len;
+}
+
+/**
+ * Called by the event loop: reads everything available on the socket and
+ * runs the reader and callback of each reply that is complete.
+ */
+bool
+Client::on_readable() {
+
+	size_t framed = m_rlen - m_rpos;
+	while(fill()) {
+		// drain the socket.
+	}
+	bool open = !m_broken;
+
+	m_framer.feed(&m_rbuf[m_rpos + framed], m_rlen - m_rpos - framed);
+	return dispatch() && open;
+}
+
+/**
+ * Called by an io_uring event loop: appends bytes read on our behalf to
+ * the receive buffer.
+ */
+void
+Client::received(const char *data, size_t sz) {
+
+	if(m_pins) {
+		if(m_rlen + sz > m_rbuf.size()) {
+			retire();
+		}
+	} else if(m_rpos == m_rlen) {
+		m_rpos = m_rlen = 0;
+	} else if(m_rpos && m_rlen + sz > m_rbuf.size()) {
+		::memmove(&m_rbuf[0], &m_rbuf[m_rpos], m_rlen - m_rpos);
+		m_rlen -= m_rpos;
+		m_rpos = 0;
+	}
+
+	if(m_rlen + sz > m_rbuf.size()) {
+		m_rbuf.resize(max(2 * m_rbuf.size(), m_rlen + sz));
+	}
+	::memcpy(&m_rbuf[m_rlen], data, sz);
+	m_rlen += sz;
+	m_framer.feed(data, sz);
+}
+
+/**
+ * Runs the reader and callback of each reply that is complete in the
+ * receive buffer.
+ */
+bool
+Client::dispatch() {
+
+	while(!m_pending.empty() && m_framer.next()) {
+		pair<ResponseReader, Callback> p = std::move(m_pending.front());
+		m_pending.pop_front();
+
+		// the whole reply is buffered, this won't block.
+		Response resp = (this->*p.first)();
+		if(p.second) {
+			p.second(resp);
+		}
+		if(!m_loop) { // detached by the callback
+			return true;
+		}
+	}
+	return !m_framer.failed();
+}
+
+/**
+ * Called by the event loop: sends as much of the queued commands as the
+ * socket accepts.
+ */
+bool
+Client::on_writable() {
+
+	while(m_wpos < m_cmd.size()) {
+		ssize_t sent = ::send(m_fd, &m_cmd[m_wpos], m_cmd.size() - m_wpos, MSG_NOSIGNAL);
+		if(sent < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		m_wpos += sent;
+	}
+
+	m_cmd.clear();
+	m_wpos = 0;
+	return m_loop->watch(*this, false);
+}
+
+/**
+ * Drops the unsent commands and fails all the pending callbacks.
+ */
+void
+Client::fail_pending() {
+
+	m_cmd.clear();
+	m_wpos = 0;
+	m_mget_keys.clear();
+	m_framer.reset();
+
+	while(!m_pending.empty()) {
+		pair<ResponseReader, Callback> p = std::move(m_pending.front());
+		m_pending.pop_front();
+
+		Response err(REDIS_ERR);
+		if(p.second) {
+			p.second(err);
+		}
+	}
+}
+
+vector<Response>
+Client::exec_multi() {
+
+	vector<ResponseReader> readers;
+	readers.swap(m_readers);
 	m_multi = false;
+
+	// MULTI, the commands and EXEC in one write. Nothing was sent before,
+	// so the connection may be reopened first.
+	Command cmd("EXEC");
+	cmd.append_to(m_cmd);
+
+	// A stale connection is reopened and the whole transaction sent again,
+	// from MULTI on: the server drops a MULTI left unfinished by a closed
+	// connection.
+	bool sent = connected() || reopen();
+	for(int attempt = 0; sent && attempt < 2; ++attempt) {
+		struct iovec iov;
+		iov.iov_base = &m_cmd[0];
+		iov.iov_len = m_cmd.size();
+		if(send(&iov, 1)) {
+			break;
+		}
+		sent = (attempt == 0 && reopen());
+	}
 	m_cmd.clear();
-	m_readers.clear();
+	if(!sent) {
+		m_mget_keys.clear();
+		return vector<Response>(); // fail.
+	}
+
+	// then read the acknowledgements, commands that were refused having no
+	// reply in EXEC's.
+	bool ok = read_status_code().get<bool>();
+	vector<char> queued(readers.size());
+	long count = 0;
+	for(size_t i = 0; i < readers.size(); ++i) {
+		queued[i] = (read_queued().type() == REDIS_QUEUED);
+		count += queued[i];
+	}
+
+	long n;
+	char type = read_header(n);
+	if(!ok || type != '*' || n != count) {
+		for(long i = 0; type == '*' && i < n; ++i) {
+			skip_reply();
+		}
+		m_mget_keys.clear();
+		return vector<Response>(); // fail.
+	}
+
+	// read back each response, their strings sharing one arena.
+	vector<Response> ret;
+	m_arena = make_shared<pmr::monotonic_buffer_resource>();
+	ret.reserve(readers.size());
+	for(size_t i = 0; i < readers.size(); ++i) {
+		if(queued[i]) {
+			ret.push_back((this->*readers[i])());
+		} else {
+			if(readers[i] == &Client::read_multi_string && !m_mget_keys.empty()) {
+				m_mget_keys.pop_front(); // the keys of a refused MGET
+			}
+			ret.push_back(Response(REDIS_ERR));
+		}
+	}
+	m_arena.reset();
 
 	return ret;
 }
 
 vector<Response>
 Client::exec_pipeline() {
+
+	pump(true);
+
 	vector<Response> ret;
+	ret.swap(m_replies);
+	m_arena.reset();
+
+	// cleanup
+	m_mget_keys.clear();
+	m_pipeline = false;
+	m_cmd.clear();
+	m_wpos = 0;
+	m_sent = m_acked = 0;
+
+	return ret;
+}
+
+/**
+ * Records the command just appended to the pipeline, and starts sending
+ * the pipeline once more than a window of it is waiting. Not from the
+ * callbacks of its replies, which are called while it is being sent.
+ */
+void
+Client::pipelined(ResponseReader fun) {
+
+	handled(fun);
+	m_ends.push_back(m_sent + m_cmd.size() - m_wpos);
+	if(!m_pumping && (m_cmd.size() - m_wpos >= m_window_bytes || m_ends.size() >= 2 * m_window_commands)) {
+		pump(false);
+	}
+}
+
+/**
+ * Writes the pipeline and reads its replies at the same time, keeping no
+ * more than a window in flight. Stops when all the replies have been read
+ * or, unless `all` is set, when less than a window is left waiting. If the
+ * connection fails, the replies that were not read are errors.
+ */
+bool
+Client::pump(bool all) {
+
+	if(!m_arena) { // replies share an arena until exec() hands them out.
+		m_arena = make_shared<pmr::monotonic_buffer_resource>();
+	}
+	bool ok = connected() || (m_sent == 0 && reopen());
+
+	while(ok) {
+		// take the replies that are complete, they are read without blocking.
+		// Those with a callback are handed to it instead of being kept.
+		while(!m_ends.empty() && m_framer.next()) {
+			pair<ResponseReader, Callback> p = std::move(m_pending.front());
+			m_pending.pop_front();
+			m_acked = m_ends.front();
+			m_ends.pop_front();
+
+			// replies handed to a callback don't outlive it, they are
+			// allocated on the heap and freed one by one.
+			Arena kept;
+			if(p.second) {
+				kept.swap(m_arena);
+			}
+			Response resp = (this->*p.first)();
+			if(p.second) {
+				m_arena.swap(kept);
+				m_pumping = true;
+				p.second(resp);
+				m_pumping = false;
+			} else {
+				m_replies.push_back(std::move(resp));
+			}
+		}
+		size_t unsent = m_cmd.size() - m_wpos;
+		if(m_broken || m_framer.failed()) {
+			ok = false;
+			break;
+		}
+		if(all ? m_ends.empty() : (unsent < m_window_bytes && m_ends.size() < 2 * m_window_commands)) {
+			break;
+		}
+
+		// what may be sent: up to a window of bytes and commands past the
+		// last reply, and at least one command.
+		size_t limit = m_acked + m_window_bytes;
+		if(m_ends.size() >= m_window_commands) {
+			limit = min(limit, m_ends[m_window_commands - 1]);
+		}
+		if(m_sent == m_acked && !m_ends.empty()) {
+			limit = max(limit, m_ends.front());
+		}
+		limit = min(limit, m_sent + unsent);
+
+		struct pollfd pfd;
+		pfd.fd = m_fd;
+		pfd.events = POLLIN | (m_sent < limit ? POLLOUT : 0);
+		pfd.revents = 0;
+		int n = poll(&pfd, 1, m_io_timeout > 0 ? m_io_timeout : -1);
+		if(n < 0 && errno == EINTR) {
+			continue;
+		}
+		if(n <= 0) {
+			m_broken = true;
+			ok = false;
+			break;
+		}
 
-	int wret = write(m_fd, &m_cmd[0], m_cmd.size());
-	(void)wret; // TODO: check return value.
+		if(pfd.revents & POLLOUT) {
+			ssize_t sent = ::send(m_fd, &m_cmd[m_wpos], limit - m_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if(sent > 0) {
+				m_wpos += sent;
+				m_sent += sent;
+				if(m_wpos == m_cmd.size()) {
+					m_cmd.clear();
+					m_wpos = 0;
+				} else if(m_wpos >= m_window_bytes) {
+					m_cmd.erase(0, m_wpos);
+					m_wpos = 0;
+				}
+			} else if(sent < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+				m_broken = true;
+			}
+		}
+		if(pfd.revents & (POLLIN | POLLERR | POLLHUP)) {
+			size_t framed = m_rlen - m_rpos;
+			if(fill()) {
+				m_framer.feed(&m_rbuf[m_rpos + framed], m_rlen - m_rpos - framed);
+			}
+		}
+	}
+
+	if(!ok) { // nothing more will come, the replies kept hold the arena.
+		m_broken = true;
+		m_arena.reset();
+		m_mget_keys.clear();
+		m_ends.clear();
+		m_cmd.clear();
+		m_wpos = 0;
+		while(!m_pending.empty()) {
+			pair<ResponseReader, Callback> p = std::move(m_pending.front());
+			m_pending.pop_front();
+
+			Response err(REDIS_ERR);
+			if(p.second) {
+				p.second(err);
+			} else {
+				m_replies.push_back(err);
+			}
+		}
+	}
+	return ok;
+}
+
+
+Response
+Client::read_string() {
+
+	Response ret(REDIS_ERR, m_arena);
+
+	Buffer s(memory());
+	bool found;
+	if(!read_bulk(s, found) || !found) {
+		return ret;
+	}
+
+	// set string.
+	ret.type(REDIS_STRING);
+	ret.set(std::move(s));
+	return ret;
+}
+
+/**
+ * Reads a bulk string into out, which is left empty if the key was not
+ * found. Returns false if the reply was something else.
+ */
+bool
+Client::read_bulk(Buffer &out, bool &found) {
+
+	long sz;
+	found = false;
+	if(read_header(sz) != '$') {
+		return false;
+	}
+	if(sz == -1) {
+		return true; // not found
+	}
+
+	out.resize(sz);
+	char crlf[2];
+
+	// read payload, then the trailing \r\n
+	if((sz && !read_bytes(&out[0], sz)) || !read_bytes(crlf, 2)) {
+		return false;
+	}
+	found = true;
+	return true;
+}
+
+/**
+ * Where strings are allocated: the arena of the batch being read, if any.
+ */
+std::pmr::memory_resource *
+Client::memory() const {
+	return m_arena ? m_arena.get() : std::pmr::get_default_resource();
+}
+
+/**
+ * Reads more data from the socket into the receive buffer, moving any
+ * unread bytes to the front first and growing the buffer if it is full.
+ */
+bool
+Client::fill() {
+
+	if(m_pins) { // views point before m_rpos, leave them alone.
+		if(m_rlen == m_rbuf.size()) {
+			retire();
+		}
+	} else if(m_rpos == m_rlen) {
+		m_rpos = m_rlen = 0;
+	} else if(m_rpos) {
+		::memmove(&m_rbuf[0], &m_rbuf[m_rpos], m_rlen - m_rpos);
+		m_rlen -= m_rpos;
+		m_rpos = 0;
+	}
+
+	if(m_rlen == m_rbuf.size()) {
+		m_rbuf.resize(2 * m_rbuf.size());
+	}
+
+	int got;
+	do {
+		got = read(m_fd, &m_rbuf[m_rlen], m_rbuf.size() - m_rlen);
+	} while(got == -1 && errno == EINTR);
+
+	if(got <= 0) {
+		// EAGAIN is a timeout, unless the event loop made the socket non-blocking.
+		if(got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK) || !m_loop) {
+			m_broken = true;
+		}
+		return false;
+	}
+	m_rlen += got;
+	return true;
+}
+
+/**
+ * Moves the unread bytes to a new receive buffer, keeping the current one
+ * alive for the views that point into it. Only those views pin the new one.
+ */
+void
+Client::retire() {
 
-	// read back each response
-	vector<ResponseReader>::const_iterator funptr;
-	for(funptr = m_readers.begin(); funptr != m_readers.end(); funptr++) {
-		Response resp = (this->**funptr)();
-		ret.push_back(resp);
+	size_t unread = m_rlen - m_rpos;
+	vector<char> fresh(max(m_rbuf.size(), 2 * unread));
+	if(unread) {
+		::memcpy(&fresh[0], &m_rbuf[m_rpos], unread);
 	}
 
-	// cleanup
-	m_pipeline = false;
-	m_cmd.clear();
-	m_readers.clear();
-
-	return ret;
+	if(m_pins) {
+		m_retired.push_back(Retired());
+		m_retired.back().gen = m_rgen;
+		m_retired.back().pins = m_pins;
+		m_retired.back().buf.swap(m_rbuf);
+	}
+	m_rbuf.swap(fresh);
+	m_rgen++;
+	m_pins = 0;
+	m_rpos = 0;
+	m_rlen = unread;
 }
 
+/**
+ * Called when a view into buffer gen is released. A retired buffer is
+ * freed with its last view, so a long-lived view only keeps its own.
+ */
+void
+Client::unpin(size_t gen) {
 
-Response
-Client::read_string() {
-
-	Response ret(REDIS_ERR);
-
-	std::string str = getline();
-	if(str[0] == '$') {
-		int sz = ::atol(str.c_str()+1);
-		if(sz == -1) {
-			return ret; // not found
+	if(gen == m_rgen) {
+		m_pins--;
+		return;
+	}
+	for(size_t i = 0; i < m_retired.size(); ++i) {
+		if(m_retired[i].gen == gen) {
+			if(--m_retired[i].pins == 0) {
+				m_retired.erase(m_retired.begin() + i);
+			}
+			return;
 		}
+	}
+}
 
-		if(sz) {
-			// need to read last \r\n
-			char *buf = new char[sz + 2];
-
-			int remain = sz + 2;
-			while(remain) {
-				int got = read(m_fd, buf + sz + 2 - remain, remain);
-				remain -= got;
+/**
+ * Copies exactly sz bytes of the reply into dst. Large payloads are read
+ * straight into dst once the receive buffer has been drained.
+ */
+bool
+Client::read_bytes(char *dst, size_t sz) {
+
+	while(sz) {
+		size_t avail = m_rlen - m_rpos;
+		if(avail) {
+			size_t n = avail < sz ? avail : sz;
+			::memcpy(dst, &m_rbuf[m_rpos], n);
+			m_rpos += n;
+			dst += n;
+			sz -= n;
+		} else if(sz >= m_rbuf.size()) {
+			int got = read(m_fd, dst, sz);
+			if(got == -1 && errno == EINTR) {
+				continue;
 			}
+			if(got <= 0) {
+				m_broken = true;
+				return false;
+			}
+			dst += got;
+			sz -= got;
+		} else if(!fill()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Returns the next line in the receive buffer, including its trailing
+ * \r\n. The pointer is only valid until the buffer is refilled.
+ */
+const char *
+Client::read_line(size_t &sz) {
 
-			Buffer s;
-			s.insert(s.end(), buf, buf+sz);
-			delete[] buf;
-			// set string.
-			ret.type(REDIS_STRING);
-			ret.set(s);
+	size_t scanned = 0;
+	while(true) {
+		const char *start = &m_rbuf[m_rpos];
+		const char *nl = find_lf(start + scanned, m_rlen - m_rpos - scanned);
+		if(nl) {
+			sz = nl + 1 - start;
+			m_rpos += sz;
+			return start;
+		}
+		scanned = m_rlen - m_rpos;
+		if(!fill()) {
+			return 0;
 		}
-		return ret;
 	}
+}
 
-	return ret;
+/**
+ * Reads a header line, returning its type marker and the number after it,
+ * or 0 if the connection failed.
+ */
+char
+Client::read_header(long &n) {
+
+	size_t sz;
+	const char *line = read_line(sz);
+	if(!line) {
+		return 0;
+	}
+	n = parse_long(line + 1, line + sz);
+	return line[0];
 }
 
 std::string
 Client::getline() {
 
-	char c;
-	string ret;
-	while(read(m_fd, &c, 1) != -1) {
-		ret.push_back(c);
-		if(c == '\n') {
-			break;
-		}
+	size_t sz;
+	const char *line = read_line(sz);
+	if(!line) {
+		return string();
 	}
-	return ret;
+	return string(line, sz);
 }
 
 Response
@@ -236,7 +1447,7 @@ Client::read_single_line() {
 		}
 		Buffer s(&str[1]);
 		ret.type(REDIS_STRING);
-		ret.set(s);
+		ret.set(std::move(s));
 	}
 	return ret;
 }
@@ -245,38 +1456,115 @@ Response
 Client::read_queued() {
 	Response ret(REDIS_ERR);
 
-	std::string str = getline();
-	if(str == "+QUEUED") {
+	size_t sz;
+	const char *line = read_line(sz);
+	if(line && sz >= 7 && ::memcmp(line, "+QUEUED", 7) == 0) {
 		ret.type(REDIS_QUEUED);
 	}
 	return ret;
 }
 
+/**
+ * Reads a bulk string, passing its payload to sink in chunks as it comes
+ * in, so that memory use is bounded by the receive buffer. Returns its
+ * length, or an error if it was not found or the sink gave up.
+ */
+Response
+Client::read_string_to(const Sink &sink) {
+
+	Response ret(REDIS_ERR);
+
+	long sz;
+	if(read_header(sz) != '$') {
+		return ret;
+	}
+	if(sz < 0) {
+		return ret; // not found
+	}
+
+	// the whole payload is read even if the sink fails, to stay in sync.
+	bool ok = true;
+	for(long left = sz; left; ) {
+		size_t avail = m_rlen - m_rpos;
+		if(!avail) {
+			if(!fill()) {
+				return ret;
+			}
+			continue;
+		}
+		size_t n = avail < (size_t)left ? avail : left;
+		ok = ok && sink(&m_rbuf[m_rpos], n);
+		m_rpos += n;
+		left -= n;
+	}
+
+	char crlf[2];
+	if(!read_bytes(crlf, 2) || !ok) {
+		return ret;
+	}
+	ret.type(REDIS_LONG);
+	ret.set(sz);
+	return ret;
+}
+
 Response
 Client::read_integer() {
 	Response ret(REDIS_ERR);
 
-	std::string str = getline();
-	if(str[0] == ':') {
+	long l;
+	if(read_header(l) == ':') {
 		ret.type(REDIS_LONG);
-		ret.set(::atol(&str[1]));
+		ret.set(l);
 	}
 	return ret;
 }
 
 Response
 Client::read_double() {
-	Response ret = read_string();
-	if(ret.type() != REDIS_STRING) {
+	Response ret(REDIS_ERR);
+
+	double d;
+	bool found;
+	if(!read_bulk(d, found) || !found) {
 		return ret;
 	}
-	string s = ret.get<string>();
 	ret.type(REDIS_DOUBLE);
-	ret.set(atof(&s[0]));
+	ret.set(d);
 
 	return ret;
 }
 
+/**
+ * Reads a bulk string as a double, parsing it where it lies in the
+ * receive buffer.
+ */
+bool
+Client::read_bulk(double &out, bool &found) {
+
+	long sz;
+	found = false;
+	if(read_header(sz) != '$') {
+		return false;
+	}
+	if(sz < 0) {
+		return true; // not found
+	}
+	while(m_rlen - m_rpos < (size_t)sz + 2) {
+		if(!fill()) {
+			return false;
+		}
+	}
+	const char *p = &m_rbuf[m_rpos], *end = p + sz;
+	m_rpos += sz + 2;
+
+	p += (p < end && *p == '+'); // +inf
+	if(from_chars(p, end, out).ec != errc()) {
+		return false;
+	}
+	found = true;
+	return true;
+}
+
 /**
  * Reads :1 as true, :0 as false.
  */
@@ -284,10 +1572,9 @@ Response
 Client::read_integer_as_bool() {
 	Response ret(REDIS_ERR);
 
-	std::string str = getline();
-	if(str[0] == ':') {
-		long l;
-		switch((l = ::atol(&str[1]))) {
+	long l;
+	if(read_header(l) == ':') {
+		switch(l) {
 			case 0:
 			case 1:
 				ret.type(REDIS_BOOL);
@@ -301,67 +1588,206 @@ Client::read_integer_as_bool() {
 Response
 Client::read_multi_bulk() {
 	Response err(REDIS_ERR);
-	Response ret(REDIS_LIST);
+	Response ret(REDIS_LIST, m_arena);
 
-	std::string str = getline();
-	if(str[0] != '*') {
+	long count;
+	if(read_header(count) != '*') {
 		return err;
 	}
-	long count = ::atol(&str[1]);
 	if(count <= 0) {
 		return ret;
 	}
+	ret.reserve(count);
+
+	// nil elements are empty strings. Other elements than bulks make it an
+	// error, but the reply is still read to its end.
+	bool failed = false;
 	for(long i = 0; i < count; ++i) {
-		Response s = read_string();
-		if(s.type() != REDIS_STRING) {
+		while(m_rpos == m_rlen) {
+			if(!fill()) {
+				return err;
+			}
+		}
+		if(m_rbuf[m_rpos] != '$') {
+			failed = true;
+			if(skip_reply().type() == REDIS_ERR) {
+				return err;
+			}
+			continue;
+		}
+		Buffer s(memory());
+		bool found;
+		if(!read_bulk(s, found)) {
 			return err;
 		}
-		ret.addString(s.get<redis::Buffer>());
+		ret.addString(std::move(s));
 	}
-	return ret;
+	return failed ? err : ret;
 }
 
 Response
 Client::read_multi_string() {
 
-	std::string str = getline();
-	if(str[0] != '*' || m_mget_keys.size() == 0) {
+	if(m_mget_keys.empty()) {
+		return Response(REDIS_ERR);
+	}
+	List keys = std::move(m_mget_keys.front());
+	m_mget_keys.pop_front();
+
+	long count;
+	if(read_header(count) != '*') {
 		return Response(REDIS_ERR);
 	}
-	long count = ::atol(&str[1]);
-	List keys = *(m_mget_keys.rbegin());
-	m_mget_keys.pop_back();
 	if(count <= 0 || count != (int)keys.size()) {
 		return Response(REDIS_ERR);
 	}
 
-	Response ret(REDIS_HASH);
+	Response ret(REDIS_HASH, m_arena);
+	ret.reserve(keys.size());
 	List::iterator k;
 	for(k = keys.begin(); k != keys.end(); k++) {
-		Response v = read_string();
-		if(v.type() == REDIS_STRING) { // key found
-			ret.addString(*k, v.get<Buffer>());
+		Buffer v(memory());
+		bool found;
+		if(read_bulk(v, found) && found) {
+			ret.addString(std::move(*k), std::move(v));
 		}
 	}
 	return ret;
 }
 
 
+/**
+ * Reads a reply of any type: status lines and bulks as strings, integers
+ * as longs, multi-bulks as lists, and errors as REDIS_ERR.
+ */
+Response
+Client::read_any() {
+
+	// peek at the type, the line stays in the buffer.
+	size_t sz;
+	const char *line = read_line(sz);
+	if(!line) {
+		return Response(REDIS_ERR);
+	}
+	m_rpos -= sz;
+
+	switch(line[0]) {
+		case '+':
+			return read_single_line();
+		case ':':
+			return read_integer();
+		case '$':
+			return read_string();
+		case '*':
+			return read_multi_bulk();
+	}
+	read_line(sz);
+	return Response(REDIS_ERR);
+}
+
+/**
+ * Buffers a whole reply and parses it in place into out, which pins the
+ * receive buffer until it is released.
+ */
+bool
+Client::read_view(ReplyView &out) {
+
+	// only scan what each read brings in.
+	size_t sz = 0;
+	long remaining = 1;
+	while(!scan_reply(&m_rbuf[m_rpos], m_rlen - m_rpos, sz, remaining)) {
+		if(!fill()) {
+			return false;
+		}
+	}
+
+	const char *p = &m_rbuf[m_rpos], *end = p + sz;
+	m_rpos += sz;
+	m_pins++;
+	out.m_client = this;
+	out.m_gen = m_rgen;
+
+	char t = *p;
+	const char *nl = find_lf(p, sz);
+	long n = parse_long(p + 1, nl);
+	switch(t) {
+		case '+':
+		case '-':
+			out.m_type = (t == '+') ? REDIS_STRING : REDIS_ERR;
+			out.m_items.push_back(string_view(p + 1, nl - p - 2));
+			break;
+
+		case ':':
+			out.m_type = REDIS_LONG;
+			out.m_long = n;
+			break;
+
+		case '$':
+			if(n >= 0) { // otherwise not found
+				out.m_type = REDIS_STRING;
+				out.m_items.push_back(string_view(nl + 1, n));
+			}
+			break;
+
+		case '*':
+			out.m_type = REDIS_LIST;
+			out.m_items.reserve(n > 0 ? n : 0);
+			for(p = nl + 1; n > 0; --n) {
+				nl = find_lf(p, end - p);
+				long len = parse_long(p + 1, nl);
+				if(*p != '$') { // nested or inline: not for views.
+					out.m_type = REDIS_ERR;
+					out.m_items.clear();
+					break;
+				}
+				if(len < 0) {
+					out.m_items.push_back(string_view());
+					p = nl + 1;
+				} else {
+					out.m_items.push_back(string_view(nl + 1, len));
+					p = nl + 1 + len + 2;
+				}
+			}
+			break;
+	}
+	return true;
+}
+
+/**
+ * Skips the next reply without decoding it.
+ */
+Response
+Client::skip_reply() {
+
+	size_t sz = 0;
+	long remaining = 1;
+	while(!scan_reply(&m_rbuf[m_rpos], m_rlen - m_rpos, sz, remaining)) {
+		if(!fill()) {
+			return Response(REDIS_ERR);
+		}
+	}
+	m_rpos += sz;
+	return Response(REDIS_QUEUED);
+}
+
 Response
 Client::read_key_value_list() {
-	Response bulk = read_multi_bulk();
-	if(bulk.type() != REDIS_LIST || (bulk.size() % 2 != 0)) {
+	long count;
+	if(read_header(count) != '*' || (count > 0 && count % 2 != 0)) {
 		return Response(REDIS_ERR);
 	}
-	redis::List l = bulk.get<vector<Buffer> >();
 
-	Response ret(REDIS_HASH);
-	redis::List::const_iterator i;
-	for(i = l.begin(); i != l.end(); i++) {
-		redis::Buffer key = *i;
-		i++;
-		redis::Buffer val = *i;
-		ret.addString(key, val);
+	Response ret(REDIS_HASH, m_arena);
+	if(count > 0) {
+		ret.reserve(count / 2);
+	}
+	for(long i = 0; i < count; i += 2) {
+		Buffer key(memory()), val(memory());
+		bool found_key, found_val;
+		if(!read_bulk(key, found_key) || !read_bulk(val, found_val) || !found_key || !found_val) {
+			return Response(REDIS_ERR);
+		}
+		ret.addString(std::move(key), std::move(val));
 	}
 	return ret;
 }
@@ -403,23 +1829,33 @@ Client::read_type_reply() {
 /* actual redis commands */
 
 Response
-Client::auth(Buffer key) {
+Client::auth(BufferRef key) {
 	Command cmd("AUTH");
-
 	cmd << key;
-	return run(cmd, &Client::read_status_code);
+	Response ret = run(cmd, &Client::read_status_code);
+
+	// replayed on reconnection once accepted, not from MULTI or a pipeline.
+	if(ret.type() == REDIS_BOOL && ret.get<bool>()) {
+		m_password = Buffer(key);
+	}
+	return ret;
 }
 
 Response
 Client::select(int index) {
 	Command cmd("SELECT");
-
 	cmd << (long)index;
-	return run(cmd, &Client::read_status_code);
+	Response ret = run(cmd, &Client::read_status_code);
+
+	// replayed on reconnection once accepted, like the password.
+	if(ret.type() == REDIS_BOOL && ret.get<bool>()) {
+		m_db = index;
+	}
+	return ret;
 }
 
 Response
-Client::keys(Buffer pattern) {
+Client::keys(BufferRef pattern) {
 	Command cmd("KEYS");
 
 	cmd << pattern;
@@ -466,76 +1902,166 @@ Client::bgrewriteaof() {
 }
 
 Response
-Client::move(Buffer key, int index) {
+Client::move(BufferRef key, int index) {
 	Command cmd("MOVE");
 	cmd << key << (long)index;
 	return run(cmd, &Client::read_integer_as_bool);
 }
 
 Response
-Client::sort(Buffer key) {
+Client::sort(BufferRef key) {
 	Command cmd("SORT");
 	cmd << key;
 	return run(cmd, &Client::read_multi_bulk);
 }
 
 Response
-Client::sort(Buffer key, SortParams params) {
+Client::sort(BufferRef key, SortParams params) {
 	Command cmd = params.buildCommand(key);
 	return run(cmd, &Client::read_multi_bulk);
 }
 
 Response
-Client::type(Buffer key) {
+Client::type(BufferRef key) {
 	Command cmd("TYPE");
 	cmd << key;
 	return run(cmd, &Client::read_type_reply);
 }
 
 Response
-Client::append(Buffer key, Buffer padding) {
+Client::append(BufferRef key, BufferRef padding) {
 	Command cmd("APPEND");
 	cmd << key << padding;
 	return run(cmd, &Client::read_integer);
 
 }
+
+Response
+Client::append_from(BufferRef key, const void *data, size_t sz) {
+	Command cmd("APPEND");
+	cmd << key;
+	return run_payload(cmd, data, -1, 0, sz, &Client::read_integer);
+}
+
+Response
+Client::append_from(BufferRef key, int fd, off_t offset, size_t sz) {
+	Command cmd("APPEND");
+	cmd << key;
+	return run_payload(cmd, 0, fd, offset, sz, &Client::read_integer);
+}
 Response
-Client::substr(Buffer key, int start, int end) {
+Client::substr(BufferRef key, int start, int end) {
 	Command cmd("SUBSTR");
 	cmd << key << (long)start << (long)end;
 	return run(cmd, &Client::read_string);
 }
 Response
-Client::config(Buffer key, Buffer field) {
+Client::config(BufferRef key, BufferRef field) {
 	Command cmd("CONFIG");
 	cmd << key << Buffer("GET") << field;
 	return run(cmd, &Client::read_multi_bulk);
 }
 Response
-Client::config(Buffer key, Buffer field, Buffer val) {
+Client::config(BufferRef key, BufferRef field, BufferRef val) {
 	Command cmd("CONFIG");
 	cmd << key << Buffer("SET") << field << val;
 	return run(cmd, &Client::read_string);
 }
 
 Response
-Client::get(Buffer key){
+Client::get(BufferRef key){
 	Command cmd("GET");
 
 	cmd << key;
 	return run(cmd, &Client::read_string);
 }
 
+/**
+ * GET streaming the value to sink. Only for blocking clients outside of
+ * MULTI and pipelines.
+ */
+Response
+Client::get_to(BufferRef key, Sink sink) {
+
+	Command cmd("GET");
+	cmd << key;
+	if(!run_direct(cmd)) {
+		return Response(REDIS_ERR);
+	}
+	return read_string_to(sink);
+}
+
+/**
+ * GET writing the value to a file descriptor.
+ */
+Response
+Client::get_to(BufferRef key, int fd) {
+
+	return get_to(key, [fd](const char *data, size_t sz) {
+		while(sz) {
+			ssize_t n = write(fd, data, sz);
+			if(n == -1 && errno == EINTR) {
+				continue;
+			}
+			if(n <= 0) {
+				return false;
+			}
+			data += n;
+			sz -= n;
+		}
+		return true;
+	});
+}
+
+/**
+ * GET copying the value to buf. As with snprintf, the full length is
+ * returned and the value was truncated if it is larger than sz.
+ */
+Response
+Client::get_to(BufferRef key, char *buf, size_t sz) {
+
+	size_t pos = 0;
+	return get_to(key, [buf, sz, &pos](const char *data, size_t n) {
+		if(pos < sz) {
+			::memcpy(buf + pos, data, min(n, sz - pos));
+		}
+		pos += n;
+		return true;
+	});
+}
+
 Response
-Client::set(Buffer key, Buffer val) {
+Client::set(BufferRef key, BufferRef val) {
 	Command cmd("SET");
 
 	cmd << key << val;
 	return run(cmd, &Client::read_status_code);
 }
 
+/**
+ * SET from memory without copying the value, e.g. from a mapped file.
+ */
+Response
+Client::set_from(BufferRef key, const void *data, size_t sz) {
+	Command cmd("SET");
+
+	cmd << key;
+	return run_payload(cmd, data, -1, 0, sz, &Client::read_status_code);
+}
+
+/**
+ * SET with sz bytes of a file from offset, sent with sendfile(2).
+ */
+Response
+Client::set_from(BufferRef key, int fd, off_t offset, size_t sz) {
+	Command cmd("SET");
+
+	cmd << key;
+	return run_payload(cmd, 0, fd, offset, sz, &Client::read_status_code);
+}
+
 Response
-Client::getset(Buffer key, Buffer val) {
+Client::getset(BufferRef key, BufferRef val) {
 	Command cmd("GETSET");
 
 	cmd << key << val;
@@ -543,53 +2069,57 @@ Client::getset(Buffer key, Buffer val) {
 }
 
 Response
-Client::setnx(Buffer key, Buffer val) {
+Client::setnx(BufferRef key, BufferRef val) {
 	Command cmd("SETNX");
 	cmd << key << val;
 	return run(cmd, &Client::read_integer_as_bool);
 }
 
 Response
-Client::exists(Buffer key) {
+Client::exists(BufferRef key) {
 	Command cmd("EXISTS");
 	cmd << key;
 	return run(cmd, &Client::read_integer_as_bool);
 }
 
 Response
-Client::del(Buffer key) {
+Client::del(BufferRef key) {
 	Command cmd("DEL");
 	cmd << key;
 	return run(cmd, &Client::read_integer);
 }
 Response
-Client::del(List keys) {
+Client::del(const List &keys) {
 	return generic_multi_parameter("DEL", keys, &Client::read_integer);
 }
 
 Response
-Client::mget(List keys) {
-	m_mget_keys.push_back(keys);
-	return generic_multi_parameter("MGET", keys, &Client::read_multi_string);
+Client::mget(const List &keys) {
+	Command cmd("MGET");
+	List::const_iterator key;
+	for(key = keys.begin(); key != keys.end(); key++) {
+		cmd << *key;
+	}
+	return run(cmd, &Client::read_multi_string, &keys);
 }
 
 Response
-Client::expire(Buffer key, long ttl) {
+Client::expire(BufferRef key, long ttl) {
 	return generic_key_int_return_int("EXPIRE", key, ttl);
 }
 Response
-Client::expireat(Buffer key, long timestamp) {
+Client::expireat(BufferRef key, long timestamp) {
 	return generic_key_int_return_int("EXPIREAT", key, timestamp);
 }
 
 Response
-Client::mset(List keys, List vals) {
+Client::mset(const List &keys, const List &vals) {
 
 	return generic_mset("MSET", keys, vals, &Client::read_status_code);
 }
 
 Response
-Client::msetnx(List keys, List vals) {
+Client::msetnx(const List &keys, const List &vals) {
 
 	return generic_mset("MSETNX", keys, vals, &Client::read_integer_as_bool);
 }
@@ -603,33 +2133,27 @@ Client::info() {
 Response
 Client::read_info_reply() {
 
-	Response ret = read_string();
+	Response bulk = read_string();
 
-	if(ret.type() != REDIS_STRING) {
+	if(bulk.type() != REDIS_STRING) {
 		return Response(REDIS_ERR);
 	}
 
-	string s = ret.get<string>();
-	ret.type(REDIS_INFO_MAP);
-
-	// now split it on '\r'
-	size_t pos = 0, old_pos = 0;
+	// split it into key:value lines, without copying them.
+	string_view s = bulk.ref<Buffer>();
+	Response ret(REDIS_INFO_MAP);
+	size_t pos = 0;
 	while(true) {
-		pos = s.find('\r', pos);
-		if(pos == string::npos) {
+		size_t end = s.find('\r', pos);
+		if(end == string_view::npos) {
 			break;
 		}
-		string line = s.substr(old_pos, pos - old_pos);
-		pos += 2;
-		old_pos = pos;
+		string_view line = s.substr(pos, end - pos);
+		pos = end + 2;
 
-		// now split the line on ':'
 		size_t colon_pos = line.find(':');
-		if(colon_pos != string::npos) {
-			string key = line.substr(0, colon_pos);
-			string val = line.substr(colon_pos + 1);
-
-			ret.addString(key, val);
+		if(colon_pos != string_view::npos) {
+			ret.addString(Buffer(line.substr(0, colon_pos)), Buffer(line.substr(colon_pos + 1)));
 		}
 	}
 
@@ -637,17 +2161,23 @@ Client::read_info_reply() {
 }
 
 Response
-Client::incr(Buffer key, int val) {
+Client::incr(BufferRef key, int val) {
 
-	return generic_key_int_return_int("INCR", key, val, true);
+	if(val > 1) {
+		return generic_key_int_return_int("INCRBY", key, val);
+	}
+	return generic_key_int_return_int("INCR", key, val, false);
 }
 Response
-Client::decr(Buffer key, int val) {
+Client::decr(BufferRef key, int val) {
 
-	return generic_key_int_return_int("DECR", key, val, true);
+	if(val > 1) {
+		return generic_key_int_return_int("DECRBY", key, val);
+	}
+	return generic_key_int_return_int("DECR", key, val, false);
 }
 Response
-Client::rename(Buffer src, Buffer dst) {
+Client::rename(BufferRef src, BufferRef dst) {
 
 	Command cmd("RENAME");
 	cmd << src << dst;
@@ -655,7 +2185,7 @@ Client::rename(Buffer src, Buffer dst) {
 }
 
 Response
-Client::renamenx(Buffer src, Buffer dst) {
+Client::renamenx(BufferRef src, BufferRef dst) {
 
 	Command cmd("RENAMENX");
 	cmd << src << dst;
@@ -669,7 +2199,7 @@ Client::randomkey() {
 }
 
 Response
-Client::ttl(Buffer key) {
+Client::ttl(BufferRef key) {
 	Command cmd("TTL");
 	cmd << key;
 	return run(cmd, &Client::read_integer);
@@ -685,16 +2215,16 @@ Client::ping() {
 /* List commands */
 
 Response
-Client::lpush(Buffer key, Buffer val) {
+Client::lpush(BufferRef key, BufferRef val) {
 	return generic_push("LPUSH", key, val);
 }
 Response
-Client::rpush(Buffer key, Buffer val) {
+Client::rpush(BufferRef key, BufferRef val) {
 	return generic_push("RPUSH", key, val);
 }
 
 Response
-Client::rpoplpush(Buffer src, Buffer dst) {
+Client::rpoplpush(BufferRef src, BufferRef dst) {
 
 	Command cmd("RPOPLPUSH");
 	cmd << src << dst;
@@ -702,34 +2232,34 @@ Client::rpoplpush(Buffer src, Buffer dst) {
 }
 
 Response
-Client::llen(Buffer key) {
+Client::llen(BufferRef key) {
 	Command cmd("LLEN");
 	cmd << key;
 	return run(cmd, &Client::read_integer);
 }
 
 Response
-Client::lpop(Buffer key) {
+Client::lpop(BufferRef key) {
 	return generic_pop("LPOP", key);
 }
 Response
-Client::rpop(Buffer key) {
+Client::rpop(BufferRef key) {
 	return generic_pop("RPOP", key);
 }
 
 Response
-Client::blpop(List keys, int timeout) {
+Client::blpop(const List &keys, int timeout) {
 	return generic_blocking_pop("BLPOP", keys, timeout);
 }
 
 Response
-Client::brpop(List keys, int timeout) {
+Client::brpop(const List &keys, int timeout) {
 	return generic_blocking_pop("BRPOP", keys, timeout);
 }
 
 
 Response
-Client::ltrim(Buffer key, int start, int end) {
+Client::ltrim(BufferRef key, int start, int end) {
 
 	Command cmd("LTRIM");
 	cmd << key << (long)start << (long)end;
@@ -737,7 +2267,7 @@ Client::ltrim(Buffer key, int start, int end) {
 }
 
 Response
-Client::lindex(Buffer key, int pos) {
+Client::lindex(BufferRef key, int pos) {
 
 	Command cmd("LINDEX");
 	cmd << key << (long)pos;
@@ -745,19 +2275,19 @@ Client::lindex(Buffer key, int pos) {
 }
 
 Response
-Client::lrem(Buffer key, int count, Buffer val) {
+Client::lrem(BufferRef key, int count, BufferRef val) {
 
 	return generic_list_item_action("LREM", key, count, val, &Client::read_integer);
 }
 
 Response
-Client::lset(Buffer key, int pos, Buffer val) {
+Client::lset(BufferRef key, int pos, BufferRef val) {
 
 	return generic_list_item_action("LSET", key, pos, val, &Client::read_status_code);
 }
 
 Response
-Client::lrange(Buffer key, int start, int end) {
+Client::lrange(BufferRef key, int start, int end) {
 
 	Command cmd("LRANGE");
 	cmd << key << (long)start << (long)end;
@@ -767,43 +2297,43 @@ Client::lrange(Buffer key, int start, int end) {
 /* Set commands */
 
 Response
-Client::sadd(Buffer key, Buffer val) {
+Client::sadd(BufferRef key, BufferRef val) {
 	return generic_set_key_value("SADD", key, val);
 }
 
 Response
-Client::srem(Buffer key, Buffer val) {
+Client::srem(BufferRef key, BufferRef val) {
 	return generic_set_key_value("SREM", key, val);
 }
 
 Response
-Client::spop(Buffer key) {
+Client::spop(BufferRef key) {
 	return generic_pop("SPOP", key);
 }
 
 Response
-Client::scard(Buffer key) {
+Client::scard(BufferRef key) {
 	return generic_card("SCARD", key);
 }
 Response
-Client::sismember(Buffer key, Buffer val) {
+Client::sismember(BufferRef key, BufferRef val) {
 	return generic_set_key_value("SISMEMBER", key, val);
 }
 
 Response
-Client::smembers(Buffer key) {
+Client::smembers(BufferRef key) {
 	Command cmd("SMEMBERS");
 	cmd << key;
 	return run(cmd, &Client::read_multi_bulk);
 }
 
 Response
-Client::srandmember(Buffer key) {
+Client::srandmember(BufferRef key) {
 	return generic_pop("SRANDMEMBER", key);
 }
 
 Response
-Client::smove(Buffer src, Buffer dst, Buffer member) {
+Client::smove(BufferRef src, BufferRef dst, BufferRef member) {
 
 	Command cmd("SMOVE");
 	cmd << src << dst << member;
@@ -811,41 +2341,41 @@ Client::smove(Buffer src, Buffer dst, Buffer member) {
 }
 
 Response
-Client::sinter(List keys) {
+Client::sinter(const List &keys) {
 	return generic_multi_parameter("SINTER", keys, &Client::read_multi_bulk);
 }
 Response
-Client::sunion(List keys) {
+Client::sunion(const List &keys) {
 	return generic_multi_parameter("SUNION", keys, &Client::read_multi_bulk);
 }
 Response
-Client::sdiff(List keys) {
+Client::sdiff(const List &keys) {
 	return generic_multi_parameter("SDIFF", keys, &Client::read_multi_bulk);
 }
 Response
-Client::sinterstore(List keys) {
+Client::sinterstore(const List &keys) {
 	return generic_multi_parameter("SINTERSTORE", keys, &Client::read_integer);
 }
 Response
-Client::sunionstore(List keys) {
+Client::sunionstore(const List &keys) {
 	return generic_multi_parameter("SUNIONSTORE", keys, &Client::read_integer);
 }
 Response
-Client::sdiffstore(List keys) {
+Client::sdiffstore(const List &keys) {
 	return generic_multi_parameter("SDIFFSTORE", keys, &Client::read_integer);
 }
 
 /* zset commands */
 
 Response
-Client::zadd(Buffer key, double score, Buffer member) {
+Client::zadd(BufferRef key, double score, BufferRef member) {
 	Command cmd("ZADD");
 
 	cmd << key << score << member;
 	return run(cmd, &Client::read_integer_as_bool);
 }
 Response
-Client::zrem(Buffer key, Buffer member) {
+Client::zrem(BufferRef key, BufferRef member) {
 	Command cmd("ZREM");
 
 	cmd << key << member;
@@ -853,7 +2383,7 @@ Client::zrem(Buffer key, Buffer member) {
 }
 
 Response
-Client::zincrby(Buffer key, double score, Buffer member) {
+Client::zincrby(BufferRef key, double score, BufferRef member) {
 	Command cmd("ZINCRBY");
 
 	cmd << key << score << member;
@@ -861,49 +2391,49 @@ Client::zincrby(Buffer key, double score, Buffer member) {
 }
 
 Response
-Client::zscore(Buffer key, Buffer member) {
+Client::zscore(BufferRef key, BufferRef member) {
 	Command cmd("ZSCORE");
 
 	cmd << key << member;
 	return run(cmd, &Client::read_double);
 }
 Response
-Client::zrank(Buffer key, Buffer member) {
+Client::zrank(BufferRef key, BufferRef member) {
 	return generic_zrank("ZRANK", key, member);
 }
 Response
-Client::zrevrank(Buffer key, Buffer member) {
+Client::zrevrank(BufferRef key, BufferRef member) {
 	return generic_zrank("ZREVRANK", key, member);
 }
 Response
-Client::zrange(Buffer key, long start, long end, bool withscores) {
+Client::zrange(BufferRef key, long start, long end, bool withscores) {
 	return generic_zrange("ZRANGE", key, start, end, withscores);
 }
 Response
-Client::zrevrange(Buffer key, long start, long end, bool withscores) {
+Client::zrevrange(BufferRef key, long start, long end, bool withscores) {
 	return generic_zrange("ZREVRANGE", key, start, end, withscores);
 }
 
 Response
-Client::zcard(Buffer key) {
+Client::zcard(BufferRef key) {
 	return generic_card("ZCARD", key);
 }
 
 Response
-Client::zcount(Buffer key, long start, long end) {
+Client::zcount(BufferRef key, long start, long end) {
 	return generic_z_start_end_int("ZCOUNT", key, start, end);
 }
 Response
-Client::zremrangebyrank(Buffer key, long min, long max) {
+Client::zremrangebyrank(BufferRef key, long min, long max) {
 	return generic_z_start_end_int("ZREMRANGEBYRANK", key, min, max);
 }
 Response
-Client::zremrangebyscore(Buffer key, long min, long max) {
+Client::zremrangebyscore(BufferRef key, long min, long max) {
 	return generic_z_start_end_int("ZREMRANGEBYSCORE", key, min, max);
 }
 
 Response
-Client::zrangebyscore(Buffer key, long min, long max, bool withscores) {
+Client::zrangebyscore(BufferRef key, long min, long max, bool withscores) {
 
 	Command cmd("ZRANGEBYSCORE");
 	cmd << key << min << max;
@@ -915,7 +2445,7 @@ Client::zrangebyscore(Buffer key, long min, long max, bool withscores) {
 }
 
 Response
-Client::zrangebyscore(Buffer key, long min, long max, long start, long end, bool withscores) {
+Client::zrangebyscore(BufferRef key, long min, long max, long start, long end, bool withscores) {
 
 	Command cmd("ZRANGEBYSCORE");
 	cmd << key << min << max << Buffer("LIMIT") << start << end;
@@ -927,46 +2457,46 @@ Client::zrangebyscore(Buffer key, long min, long max, long start, long end, bool
 }
 
 Response
-Client::zunion(Buffer key, List keys) {
+Client::zunion(BufferRef key, const List &keys) {
 	vector<double> v;
 	return zunion(key, keys, v, "");
 }
 Response
-Client::zunion(Buffer key, List keys, string aggregate) {
+Client::zunion(BufferRef key, const List &keys, const string &aggregate) {
 	vector<double> v;
 	return zunion(key, keys, v, aggregate);
 }
 Response
-Client::zunion(Buffer key, List keys, vector<double> weights) {
+Client::zunion(BufferRef key, const List &keys, const vector<double> &weights) {
 	return zunion(key, keys, weights, "");
 }
 Response
-Client::zunion(Buffer key, List keys, vector<double> weights, string aggregate) {
+Client::zunion(BufferRef key, const List &keys, const vector<double> &weights, const string &aggregate) {
 	return generic_z_set_operation("ZUNION", key, keys, weights, aggregate);
 }
 
 Response
-Client::zinter(Buffer key, List keys) {
+Client::zinter(BufferRef key, const List &keys) {
 	vector<double> v;
 	return zinter(key, keys, v, "");
 }
 Response
-Client::zinter(Buffer key, List keys, string aggregate) {
+Client::zinter(BufferRef key, const List &keys, const string &aggregate) {
 	vector<double> v;
 	return zinter(key, keys, v, aggregate);
 }
 Response
-Client::zinter(Buffer key, List keys, vector<double> weights) {
+Client::zinter(BufferRef key, const List &keys, const vector<double> &weights) {
 	return zinter(key, keys, weights, "");
 }
 Response
-Client::zinter(Buffer key, List keys, vector<double> weights, string aggregate) {
+Client::zinter(BufferRef key, const List &keys, const vector<double> &weights, const string &aggregate) {
 	return generic_z_set_operation("ZINTER", key, keys, weights, aggregate);
 }
 
 Response
-Client::generic_z_set_operation(string keyword, Buffer key, List keys,
-		vector<double> weights, string aggregate) {
+Client::generic_z_set_operation(const Keyword &keyword, BufferRef key, const List &keys,
+		const vector<double> &weights, const string &aggregate) {
 
 	if(weights.size() != 0 && keys.size() != weights.size()) {
 		return Response(REDIS_ERR);
@@ -999,56 +2529,56 @@ Client::generic_z_set_operation(string keyword, Buffer key, List keys,
 /* hash commands */
 
 Response
-Client::hset(Buffer key, Buffer field, Buffer val) {
+Client::hset(BufferRef key, BufferRef field, BufferRef val) {
 	Command cmd("HSET");
 	cmd << key << field << val;
 	return run(cmd, &Client::read_integer_as_bool);
 }
 Response
-Client::hget(Buffer key, Buffer field) {
+Client::hget(BufferRef key, BufferRef field) {
 	Command cmd("HGET");
 	cmd << key << field;
 	return run(cmd, &Client::read_string);
 }
 
 Response
-Client::hdel(Buffer key, Buffer field) {
+Client::hdel(BufferRef key, BufferRef field) {
 	Command cmd("HDEL");
 	cmd << key << field;
 	return run(cmd, &Client::read_integer_as_bool);
 }
 Response
-Client::hexists(Buffer key, Buffer field) {
+Client::hexists(BufferRef key, BufferRef field) {
 	Command cmd("HEXISTS");
 	cmd << key << field;
 	return run(cmd, &Client::read_integer_as_bool);
 }
 
 Response
-Client::hlen(Buffer key) {
+Client::hlen(BufferRef key) {
 	Command cmd("HLEN");
 	cmd << key;
 	return run(cmd, &Client::read_integer);
 }
 Response
-Client::hkeys(Buffer key) {
+Client::hkeys(BufferRef key) {
 	return generic_h_simple_list("HKEYS", key);
 }
 
 Response
-Client::hvals(Buffer key) {
+Client::hvals(BufferRef key) {
 	return generic_h_simple_list("HVALS", key);
 }
 
 Response
-Client::hgetall(Buffer key) {
+Client::hgetall(BufferRef key) {
 	Command cmd("HGETALL");
 	cmd << key;
 	return run(cmd, &Client::read_key_value_list);
 }
 
 Response
-Client::hincrby(Buffer key, Buffer field, double d) {
+Client::hincrby(BufferRef key, BufferRef field, double d) {
 	Command cmd("HINCRBY");
 	cmd << key << field << d;
 	return run(cmd, &Client::read_integer);
@@ -1057,7 +2587,7 @@ Client::hincrby(Buffer key, Buffer field, double d) {
 /* generic commands below */
 
 Response
-Client::generic_z_start_end_int(string keyword, Buffer key, long start, long end) {
+Client::generic_z_start_end_int(const Keyword &keyword, BufferRef key, long start, long end) {
 
 	Command cmd(keyword);
 	cmd << key << start << end;
@@ -1066,7 +2596,7 @@ Client::generic_z_start_end_int(string keyword, Buffer key, long start, long end
 
 
 Response
-Client::generic_zrange(string keyword, Buffer key, long start, long end, bool withscores) {
+Client::generic_zrange(const Keyword &keyword, BufferRef key, long start, long end, bool withscores) {
 
 	Command cmd(keyword);
 
@@ -1078,14 +2608,14 @@ Client::generic_zrange(string keyword, Buffer key, long start, long end, bool wi
 }
 
 Response
-Client::generic_zrank(string keyword, Buffer key, Buffer member) {
+Client::generic_zrank(const Keyword &keyword, BufferRef key, BufferRef member) {
 	Command cmd(keyword);
 	cmd << key << member;
 	return run(cmd, &Client::read_integer);
 }
 
 Response
-Client::generic_multi_parameter(string keyword, List &keys, ResponseReader fun) {
+Client::generic_multi_parameter(const Keyword &keyword, const List &keys, ResponseReader fun) {
 	Command cmd(keyword);
 	List::const_iterator key;
 	for(key = keys.begin(); key != keys.end(); key++) {
@@ -1095,7 +2625,7 @@ Client::generic_multi_parameter(string keyword, List &keys, ResponseReader fun)
 }
 
 Response
-Client::generic_pop(string keyword, Buffer key){
+Client::generic_pop(const Keyword &keyword, BufferRef key){
 	Command cmd(keyword);
 
 	cmd << key;
@@ -1103,7 +2633,7 @@ Client::generic_pop(string keyword, Buffer key){
 }
 
 Response
-Client::generic_push(string keyword, Buffer key, Buffer val) {
+Client::generic_push(const Keyword &keyword, BufferRef key, BufferRef val) {
 
 	Command cmd(keyword);
 	cmd << key << val;
@@ -1111,22 +2641,19 @@ Client::generic_push(string keyword, Buffer key, Buffer val) {
 }
 
 Response
-Client::generic_key_int_return_int(std::string keyword, Buffer key, int val, bool addBy) {
+Client::generic_key_int_return_int(const Keyword &keyword, BufferRef key, int val, bool withVal) {
 
-	if(val > 1 && addBy) {
-		keyword = keyword + "BY";
-	}
 	Command cmd(keyword);
 	cmd << key;
-	if(!addBy || (val > 1 && addBy)) {
+	if(withVal) {
 		cmd << (long)val;
 	}
 	return run(cmd, &Client::read_integer);
 }
 
 Response
-Client::generic_list_item_action(string keyword, Buffer key, int n,
-		Buffer val, ResponseReader fun) {
+Client::generic_list_item_action(const Keyword &keyword, BufferRef key, int n,
+		BufferRef val, ResponseReader fun) {
 	Command cmd(keyword);
 	cmd << key << (long)n << val;
 
@@ -1134,7 +2661,7 @@ Client::generic_list_item_action(string keyword, Buffer key, int n,
 }
 
 Response
-Client::generic_set_key_value(string keyword, Buffer key, Buffer val) {
+Client::generic_set_key_value(const Keyword &keyword, BufferRef key, BufferRef val) {
 
 	Command cmd(keyword);
 	cmd << key << val;
@@ -1142,7 +2669,7 @@ Client::generic_set_key_value(string keyword, Buffer key, Buffer val) {
 }
 
 Response
-Client::generic_card(string keyword, Buffer key) {
+Client::generic_card(const Keyword &keyword, BufferRef key) {
 
 	Command cmd(keyword);
 	cmd << key;
@@ -1150,7 +2677,7 @@ Client::generic_card(string keyword, Buffer key) {
 }
 
 Response
-Client::generic_mset(string keyword, List keys, List vals, ResponseReader fun) {
+Client::generic_mset(const Keyword &keyword, const List &keys, const List &vals, ResponseReader fun) {
 
 	if(keys.size() != vals.size() || keys.size() == 0) {
 		return Response(REDIS_ERR);
@@ -1167,7 +2694,7 @@ Client::generic_mset(string keyword, List keys, List vals, ResponseReader fun) {
 }
 
 Response
-Client::generic_h_simple_list(string keyword, Buffer key) {
+Client::generic_h_simple_list(const Keyword &keyword, BufferRef key) {
 	Command cmd(keyword);
 	cmd << key;
 
@@ -1175,7 +2702,7 @@ Client::generic_h_simple_list(string keyword, Buffer key) {
 }
 
 Response
-Client::generic_blocking_pop(string keyword, List keys, int timeout) {
+Client::generic_blocking_pop(const Keyword &keyword, const List &keys, int timeout) {
 
 	Command cmd(keyword);
 	
@@ -1187,5 +2714,70 @@ Client::generic_blocking_pop(string keyword, List keys, int timeout) {
 
 	return run(cmd, &Client::read_multi_bulk);
 }
+bool
+Client::get(ReplyView &out, BufferRef key) {
+	Command cmd("GET");
+	cmd << key;
+	return run(cmd, out);
+}
+
+bool
+Client::keys(ReplyView &out, BufferRef pattern) {
+	Command cmd("KEYS");
+	cmd << pattern;
+	return run(cmd, out);
+}
+
+bool
+Client::lrange(ReplyView &out, BufferRef key, int start, int end) {
+	Command cmd("LRANGE");
+	cmd << key << (long)start << (long)end;
+	return run(cmd, out);
+}
+
+bool
+Client::smembers(ReplyView &out, BufferRef key) {
+	Command cmd("SMEMBERS");
+	cmd << key;
+	return run(cmd, out);
+}
+
+/**
+ * With scores, members and scores alternate in the view.
+ */
+bool
+Client::zrange(ReplyView &out, BufferRef key, long start, long end, bool withscores) {
+	Command cmd("ZRANGE");
+	cmd << key << start << end;
+	if(withscores) {
+		cmd << Buffer("WITHSCORES");
+	}
+	return run(cmd, out);
+}
+
+bool
+Client::hkeys(ReplyView &out, BufferRef key) {
+	Command cmd("HKEYS");
+	cmd << key;
+	return run(cmd, out);
+}
+
+bool
+Client::hvals(ReplyView &out, BufferRef key) {
+	Command cmd("HVALS");
+	cmd << key;
+	return run(cmd, out);
+}
+
+/**
+ * Fields and values alternate in the view.
+ */
+bool
+Client::hgetall(ReplyView &out, BufferRef key) {
+	Command cmd("HGETALL");
+	cmd << key;
+	return run(cmd, out);
+}
+
 }
 
@@ -5,9 +5,19 @@
 #include <list>
 #include <map>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <random>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
 #include "redisCommand.h"
 #include "redisResponse.h"
 #include "redisSortParams.h"
+#include "redisEventLoop.h"
+#include "redisReplyView.h"
+#include "redisParser.h"
+#include "redisTyped.h"
 
 namespace redis {
 class Client {
@@ -16,7 +26,13 @@ class Client {
 	typedef std::vector<Response> (Client::*ResponseListReader)();
 
 public:
+	typedef std::function<void (Response &)> Callback;
+	typedef std::function<bool (const char *data, size_t sz)> Sink;
+
 	Client();
+	~Client();
+	Client(const Client &) = delete;
+	Client &operator=(const Client &) = delete;
 
 	static const long ERROR = -1;
 	static const long STRING = 1;
@@ -27,10 +43,17 @@ public:
 	static const long NONE = 6;
 
 	bool connect(std::string host = "127.0.0.1", short port = 6379);
+	bool connect_unix(std::string path);
+	bool connected() const;
+	bool reconnect();
+	void disconnect();
+	void timeout(int connect_ms, int io_ms);
+	void retry(int attempts, int min_delay_ms, int max_delay_ms);
+	void window(size_t commands, size_t bytes);
 	
-	Response auth(Buffer key);
+	Response auth(BufferRef key);
 	Response select(int index);
-	Response keys(Buffer pattern);
+	Response keys(BufferRef pattern);
 	Response dbsize();
 	Response lastsave();
 	Response flushdb();
@@ -38,127 +61,167 @@ public:
 	Response save();
 	Response bgsave();
 	Response bgrewriteaof();
-	Response move(Buffer key, int index);
-	Response sort(Buffer key);
-	Response sort(Buffer key, SortParams params);
-	Response type(Buffer key);
-	Response append(Buffer key, Buffer padding);
-	Response substr(Buffer key, int start, int end);
-	Response config(Buffer key, Buffer field);
-	Response config(Buffer key, Buffer field, Buffer val);
-
-	Response get(Buffer key);
-	Response set(Buffer key, Buffer val);
-	Response getset(Buffer key, Buffer val);
-	Response incr(Buffer key, int val = 1);
-	Response decr(Buffer key, int val = 1);
-	Response rename(Buffer src, Buffer dst);
-	Response renamenx(Buffer src, Buffer dst);
+	Response move(BufferRef key, int index);
+	Response sort(BufferRef key);
+	Response sort(BufferRef key, SortParams params);
+	Response type(BufferRef key);
+	Response append(BufferRef key, BufferRef padding);
+	Response append_from(BufferRef key, const void *data, size_t sz);
+	Response append_from(BufferRef key, int fd, off_t offset, size_t sz);
+	Response substr(BufferRef key, int start, int end);
+	Response config(BufferRef key, BufferRef field);
+	Response config(BufferRef key, BufferRef field, BufferRef val);
+
+	Response get(BufferRef key);
+	Response get_to(BufferRef key, Sink sink);
+	Response get_to(BufferRef key, int fd);
+	Response get_to(BufferRef key, char *buf, size_t sz);
+	Response set(BufferRef key, BufferRef val);
+	Response set_from(BufferRef key, const void *data, size_t sz);
+	Response set_from(BufferRef key, int fd, off_t offset, size_t sz);
+	Response getset(BufferRef key, BufferRef val);
+	Response incr(BufferRef key, int val = 1);
+	Response decr(BufferRef key, int val = 1);
+	Response rename(BufferRef src, BufferRef dst);
+	Response renamenx(BufferRef src, BufferRef dst);
 	Response randomkey();
-	Response ttl(Buffer key);
+	Response ttl(BufferRef key);
 	Response ping();
-	Response setnx(Buffer src, Buffer dst);
-	Response exists(Buffer key);
-	Response del(Buffer key);
-	Response del(List key);
-	Response mget(List keys);
-	Response expire(Buffer key, long ttl);
-	Response expireat(Buffer key, long timestamp);
-	Response mset(List keys, List vals);
-	Response msetnx(List keys, List vals);
+	Response setnx(BufferRef src, BufferRef dst);
+	Response exists(BufferRef key);
+	Response del(BufferRef key);
+	Response del(const List &keys);
+	Response mget(const List &keys);
+	Response expire(BufferRef key, long ttl);
+	Response expireat(BufferRef key, long timestamp);
+	Response mset(const List &keys, const List &vals);
+	Response msetnx(const List &keys, const List &vals);
 	Response info();
 
-	Response lpush(Buffer key, Buffer val);
-	Response rpush(Buffer key, Buffer val);
-	Response rpoplpush(Buffer src, Buffer dst);
-	Response llen(Buffer key);
-	Response lpop(Buffer key);
-	Response rpop(Buffer key);
-	Response blpop(List keys, int timeout);
-	Response brpop(List keys, int timeout);
-	Response ltrim(Buffer key, int start, int end);
-	Response lindex(Buffer key, int pos);
-	Response lrem(Buffer key, int count, Buffer val);
-	Response lset(Buffer key, int pos, Buffer val);
-	Response lrange(Buffer key, int start, int end);
-
-	Response sadd(Buffer key, Buffer val);
-	Response srem(Buffer key, Buffer val);
-	Response spop(Buffer key);
-	Response scard(Buffer key);
-	Response sismember(Buffer key, Buffer val);
-	Response smembers(Buffer key);
-	Response srandmember(Buffer key);
-	Response smove(Buffer src, Buffer dst, Buffer member);
-	Response sinter(List keys);
-	Response sunion(List keys);
-	Response sdiff(List keys);
-	Response sinterstore(List keys);
-	Response sunionstore(List keys);
-	Response sdiffstore(List keys);
-
-	Response zadd(Buffer key, double score, Buffer member);
-	Response zrem(Buffer key, Buffer member);
-	Response zincrby(Buffer key, double score, Buffer member);
-	Response zscore(Buffer key, Buffer member);
-	Response zrank(Buffer key, Buffer member);
-	Response zrevrank(Buffer key, Buffer member);
-	Response zrange(Buffer key, long start, long end, bool withscores = false);
-	Response zrevrange(Buffer key, long start, long end, bool withscores = false);
-	Response zcard(Buffer key);
-	Response zcount(Buffer key, long start, long end);
-	Response zremrangebyrank(Buffer key, long min, long max);
-	Response zremrangebyscore(Buffer key, long min, long max);
-	Response zrangebyscore(Buffer key, long min, long max, bool withscores = false);
-	Response zrangebyscore(Buffer key, long min, long max, long start, long end, bool withscores = false);
-
-	Response zunion(Buffer key, List keys);
-	Response zunion(Buffer key, List keys, std::string aggregate);
-	Response zunion(Buffer key, List keys, std::vector<double> weights);
-	Response zunion(Buffer key, List keys, std::vector<double> weights, std::string aggregate);
-
-	Response zinter(Buffer key, List keys);
-	Response zinter(Buffer key, List keys, std::string aggregate);
-	Response zinter(Buffer key, List keys, std::vector<double> weights);
-	Response zinter(Buffer key, List keys, std::vector<double> weights, std::string aggregate);
-
-	Response hset(Buffer key, Buffer field, Buffer val);
-	Response hget(Buffer key, Buffer field);
-	Response hdel(Buffer key, Buffer field);
-	Response hexists(Buffer key, Buffer field);
-	Response hlen(Buffer key);
-	Response hkeys(Buffer key);
-	Response hvals(Buffer key);
-	Response hgetall(Buffer key);
-	Response hincrby(Buffer key, Buffer field, double d);
+	Response lpush(BufferRef key, BufferRef val);
+	Response rpush(BufferRef key, BufferRef val);
+	Response rpoplpush(BufferRef src, BufferRef dst);
+	Response llen(BufferRef key);
+	Response lpop(BufferRef key);
+	Response rpop(BufferRef key);
+	Response blpop(const List &keys, int timeout);
+	Response brpop(const List &keys, int timeout);
+	Response ltrim(BufferRef key, int start, int end);
+	Response lindex(BufferRef key, int pos);
+	Response lrem(BufferRef key, int count, BufferRef val);
+	Response lset(BufferRef key, int pos, BufferRef val);
+	Response lrange(BufferRef key, int start, int end);
+
+	Response sadd(BufferRef key, BufferRef val);
+	Response srem(BufferRef key, BufferRef val);
+	Response spop(BufferRef key);
+	Response scard(BufferRef key);
+	Response sismember(BufferRef key, BufferRef val);
+	Response smembers(BufferRef key);
+	Response srandmember(BufferRef key);
+	Response smove(BufferRef src, BufferRef dst, BufferRef member);
+	Response sinter(const List &keys);
+	Response sunion(const List &keys);
+	Response sdiff(const List &keys);
+	Response sinterstore(const List &keys);
+	Response sunionstore(const List &keys);
+	Response sdiffstore(const List &keys);
+
+	Response zadd(BufferRef key, double score, BufferRef member);
+	Response zrem(BufferRef key, BufferRef member);
+	Response zincrby(BufferRef key, double score, BufferRef member);
+	Response zscore(BufferRef key, BufferRef member);
+	Response zrank(BufferRef key, BufferRef member);
+	Response zrevrank(BufferRef key, BufferRef member);
+	Response zrange(BufferRef key, long start, long end, bool withscores = false);
+	Response zrevrange(BufferRef key, long start, long end, bool withscores = false);
+	Response zcard(BufferRef key);
+	Response zcount(BufferRef key, long start, long end);
+	Response zremrangebyrank(BufferRef key, long min, long max);
+	Response zremrangebyscore(BufferRef key, long min, long max);
+	Response zrangebyscore(BufferRef key, long min, long max, bool withscores = false);
+	Response zrangebyscore(BufferRef key, long min, long max, long start, long end, bool withscores = false);
+
+	Response zunion(BufferRef key, const List &keys);
+	Response zunion(BufferRef key, const List &keys, const std::string &aggregate);
+	Response zunion(BufferRef key, const List &keys, const std::vector<double> &weights);
+	Response zunion(BufferRef key, const List &keys, const std::vector<double> &weights, const std::string &aggregate);
+
+	Response zinter(BufferRef key, const List &keys);
+	Response zinter(BufferRef key, const List &keys, const std::string &aggregate);
+	Response zinter(BufferRef key, const List &keys, const std::vector<double> &weights);
+	Response zinter(BufferRef key, const List &keys, const std::vector<double> &weights, const std::string &aggregate);
+
+	Response hset(BufferRef key, BufferRef field, BufferRef val);
+	Response hget(BufferRef key, BufferRef field);
+	Response hdel(BufferRef key, BufferRef field);
+	Response hexists(BufferRef key, BufferRef field);
+	Response hlen(BufferRef key);
+	Response hkeys(BufferRef key);
+	Response hvals(BufferRef key);
+	Response hgetall(BufferRef key);
+	Response hincrby(BufferRef key, BufferRef field, double d);
 
 	Response multi();
 	bool pipeline();
 	Response discard();
 	std::vector<Response> exec();
 
+	Client &on_reply(Callback cb);
+	Client &drop();
+	bool share();
+
+	Response execute(const PreparedCommand &p, const List &values);
+	std::vector<Response> execute(const PreparedCommand &p, const std::vector<List> &batch);
+
+	// zero-copy replies, see ReplyView.
+	bool get(ReplyView &out, BufferRef key);
+	bool keys(ReplyView &out, BufferRef pattern);
+	bool lrange(ReplyView &out, BufferRef key, int start, int end);
+	bool smembers(ReplyView &out, BufferRef key);
+	bool zrange(ReplyView &out, BufferRef key, long start, long end, bool withscores = false);
+	bool hkeys(ReplyView &out, BufferRef key);
+	bool hvals(ReplyView &out, BufferRef key);
+	bool hgetall(ReplyView &out, BufferRef key);
+
 private:
-	void run(Command &c);
-	Response run(Command &c, ResponseReader fun);
-
-	Response generic_key_int_return_int(std::string keyword, Buffer key, int val, bool addBy = false);
-	Response generic_push(std::string keyword, Buffer key, Buffer val);
-	Response generic_pop(std::string keyword, Buffer key);
-	Response generic_list_item_action(std::string keyword, Buffer key, int n, Buffer val, ResponseReader fun);
-	Response generic_set_key_value(std::string keyword, Buffer key, Buffer val);
-	Response generic_multi_parameter(std::string keyword, List &keys, ResponseReader fun);
-	Response generic_zrank(std::string keyword, Buffer key, Buffer member);
-	Response generic_zrange(std::string keyword, Buffer key, long start, long end, bool withscores);
-	Response generic_z_start_end_int(std::string keyword, Buffer key, long start, long end);
-	Response generic_card(std::string keyword, Buffer key);
-	Response generic_z_set_operation(std::string keyword, Buffer key, List keys,
-		std::vector<double> weights, std::string aggregate);
-	Response generic_mset(std::string keyword, List keys, List vals, ResponseReader fun);
-	Response generic_h_simple_list(std::string keyword, Buffer key);
-	Response generic_blocking_pop(std::string keyword, List keys, int timeout);
+	friend class EventLoop;
+	friend class ClientPool;
+	friend class ReplyView;
+	friend class TypedClient;
+	friend class Awaiter;
+
+	bool run(Command &c);
+	bool send(struct iovec *iov, size_t count, int flags = 0);
+	bool send_file(int fd, off_t offset, size_t sz);
+	Response run_payload(Command &c, const void *data, int fd, off_t offset, size_t sz, ResponseReader fun);
+	Response run(Command &c, ResponseReader fun, const List *keys = 0);
+	Response run_shared(Command &c, ResponseReader fun, const List *keys);
+	bool run_direct(Command &c);
+	bool run(Command &c, ReplyView &out);
+
+	Response generic_key_int_return_int(const Keyword &keyword, BufferRef key, int val, bool withVal = true);
+	Response generic_push(const Keyword &keyword, BufferRef key, BufferRef val);
+	Response generic_pop(const Keyword &keyword, BufferRef key);
+	Response generic_list_item_action(const Keyword &keyword, BufferRef key, int n, BufferRef val, ResponseReader fun);
+	Response generic_set_key_value(const Keyword &keyword, BufferRef key, BufferRef val);
+	Response generic_multi_parameter(const Keyword &keyword, const List &keys, ResponseReader fun);
+	Response generic_zrank(const Keyword &keyword, BufferRef key, BufferRef member);
+	Response generic_zrange(const Keyword &keyword, BufferRef key, long start, long end, bool withscores);
+	Response generic_z_start_end_int(const Keyword &keyword, BufferRef key, long start, long end);
+	Response generic_card(const Keyword &keyword, BufferRef key);
+	Response generic_z_set_operation(const Keyword &keyword, BufferRef key, const List &keys,
+		const std::vector<double> &weights, const std::string &aggregate);
+	Response generic_mset(const Keyword &keyword, const List &keys, const List &vals, ResponseReader fun);
+	Response generic_h_simple_list(const Keyword &keyword, BufferRef key);
+	Response generic_blocking_pop(const Keyword &keyword, const List &keys, int timeout);
 
 	
 	Response read_string();
+	bool read_bulk(Buffer &out, bool &found);
+	bool read_bulk(double &out, bool &found);
+	std::pmr::memory_resource *memory() const;
+	Response read_string_to(const Sink &sink);
 	Response read_integer();
 	Response read_double();
 	Response read_integer_as_bool();
@@ -170,11 +233,34 @@ private:
 	Response read_type_reply();
 	Response read_key_value_list();
 	Response read_multi_string();
+	Response read_any();
+	Response skip_reply();
 
+	bool open();
+	bool reopen();
+	bool restore();
+	void set_io_timeout();
+
+	bool fill();
+	void retire();
+	void unpin(size_t gen);
+	bool read_view(ReplyView &out);
+	bool read_bytes(char *dst, size_t sz);
+	const char *read_line(size_t &sz);
+	char read_header(long &n);
 	std::string getline();
 
 	std::vector<Response> exec_multi();
 	std::vector<Response> exec_pipeline();
+	void pipelined(ResponseReader fun);
+	void handled(ResponseReader fun);
+	bool pump(bool all);
+
+	bool on_readable();
+	bool on_writable();
+	void received(const char *data, size_t sz);
+	bool dispatch();
+	void fail_pending();
 
 
 	int m_fd; // socket
@@ -184,12 +270,86 @@ private:
 	std::vector<ResponseReader> m_readers;
 
 	// MGET
-	std::vector<List> m_mget_keys;
+	std::deque<List> m_mget_keys;
 
 	// pipeline
 	bool m_pipeline;
 	Buffer m_cmd;
 
+	// pipelines are streamed: m_cmd holds unsent commands from m_wpos on,
+	// and commands end at the offsets in m_ends until they are answered.
+	// Offsets count the pipeline's bytes from the start.
+	size_t m_window_commands;
+	size_t m_window_bytes;
+	size_t m_sent; // bytes written
+	size_t m_acked; // bytes whose replies have been read
+	std::deque<size_t> m_ends;
+	std::vector<Response> m_replies; // those without a callback
+	bool m_pumping; // in a callback
+
+	// strings of the replies to a pipeline, MULTI or batch being read.
+	Arena m_arena;
+
+	// receive buffer: unread bytes are in [m_rpos, m_rlen)
+	std::vector<char> m_rbuf;
+	size_t m_rpos;
+	size_t m_rlen;
+
+	// while views point into m_rbuf, it is replaced instead of being reused.
+	// Buffers are numbered, a retired one lives until its last view goes.
+	struct Retired {
+		size_t gen;
+		int pins;
+		std::vector<char> buf;
+	};
+	size_t m_rgen; // number of m_rbuf
+	int m_pins; // views into m_rbuf
+	std::vector<Retired> m_retired;
+
+	// asynchronous mode and pipelines: m_cmd holds unsent commands from
+	// m_wpos on, m_framer tells which of the received replies are complete,
+	// and m_pending has the reader and callback of each awaited reply.
+	EventLoop *m_loop;
+	Parser m_framer;
+	Callback m_callback;
+	bool m_drop;
+	std::deque<std::pair<ResponseReader, Callback> > m_pending;
+	size_t m_wpos;
+
+	// where to reconnect, and whether the connection has failed.
+	std::string m_host;
+	short m_port;
+	std::string m_path; // Unix socket
+	bool m_broken;
+
+	// replayed on reconnection
+	Buffer m_password;
+	int m_db;
+
+	// deadlines and reconnection policy, in milliseconds.
+	int m_connect_timeout;
+	int m_io_timeout;
+	int m_retry_attempts;
+	int m_retry_min_delay;
+	int m_retry_max_delay;
+	std::minstd_rand m_rng;
+
+	// shared mode: replies waited for by other threads, in command order.
+	struct SharedReply {
+		SharedReply(ResponseReader f) : fun(f), resp(REDIS_ERR), done(false) {}
+		ResponseReader fun;
+		Response resp;
+		bool done;
+	};
+	bool m_shared;
+	bool m_flushing;
+	std::mutex m_shared_lock;
+	std::condition_variable m_shared_cond;
+	std::vector<SharedReply*> m_shared_replies;
+	std::deque<List> m_shared_keys;
+	Buffer m_batch;
+	std::vector<SharedReply*> m_batch_replies;
+
 };
 }
 
@@ -1,26 +1,28 @@
 #include "redisBuffer.h"
-#include <cstring>
 
 using namespace std;
 
 namespace redis {
 
-Buffer::Buffer() : vector<char>() {
+Buffer::Buffer() : pmr::string() {
 
 }
-Buffer::Buffer(std::string &s) : vector<char>() {
+Buffer::Buffer(std::string &s) : pmr::string(s.data(), s.size()) {
 
-	insert(end(), s.begin(), s.end());
 }
-Buffer::Buffer(const char *s) : vector<char>() {
+Buffer::Buffer(const char *s) : pmr::string(s) {
 
-	int l = ::strlen(s);
-	insert(end(), s, s+l);
 }
 
-Buffer::Buffer(const char *s, size_t sz) : vector<char>() {
+Buffer::Buffer(const char *s, size_t sz) : pmr::string(s, sz) {
 
-	insert(end(), s, s+sz);
 }
+
+Buffer::Buffer(std::string_view s) : pmr::string(s) {
+
 }
 
+Buffer::Buffer(std::pmr::memory_resource *r) : pmr::string(r) {
+
+}
+}
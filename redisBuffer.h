@@ -3,15 +3,44 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <span>
+#include <memory_resource>
 
 namespace redis {
-class Buffer : public std::vector<char> {
+
+/**
+ * An owned string of bytes. Short ones, like most keys, are stored inline
+ * without any allocation, and moving one never copies its bytes.
+ *
+ * Long ones are allocated from a memory resource, the heap by default.
+ * Copies are always made on the heap.
+ */
+class Buffer : public std::pmr::string {
 
 	public:
 		Buffer();
 		Buffer(std::string &s);
 		Buffer(const char *s);
 		Buffer(const char *s, size_t sz);
+		explicit Buffer(std::string_view s);
+		explicit Buffer(std::pmr::memory_resource *r);
+
+};
+
+/**
+ * A borrowed string of bytes, for arguments that are only read: keys and
+ * values are passed to commands without being copied.
+ */
+class BufferRef : public std::string_view {
+
+	public:
+		BufferRef(const char *s) : std::string_view(s) {}
+		BufferRef(const char *s, size_t sz) : std::string_view(s, sz) {}
+		BufferRef(const std::string &s) : std::string_view(s) {}
+		BufferRef(const std::pmr::string &s) : std::string_view(s) {}
+		BufferRef(std::string_view s) : std::string_view(s) {}
+		BufferRef(std::span<const char> s) : std::string_view(s.data(), s.size()) {}
 
 };
 
@@ -20,4 +49,3 @@ typedef std::vector<Buffer> List;
 }
 
 #endif /* REDIS_STRING_H */
-
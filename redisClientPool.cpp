@@ -0,0 +1,179 @@
+#include "redisClientPool.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+namespace redis {
+
+// the last connection used by this thread, tried first on checkout. Pools
+// are told apart by id, as a new one may reuse the address of an old one.
+static atomic<uint64_t> s_last_id(0);
+static thread_local uint64_t t_last_pool = 0;
+static thread_local size_t t_last_slot = 0;
+
+ClientPool::ClientPool(size_t size, std::string host, short port) :
+	m_slots(new Slot[size]),
+	m_size(size),
+	m_id(s_last_id.fetch_add(1, memory_order_relaxed) + 1),
+	m_next(0),
+	m_checkouts(0),
+	m_affinity_hits(0),
+	m_waits(0),
+	m_wait_ns(0),
+	m_replaced(0),
+	m_in_use(0) {
+
+	for(size_t i = 0; i < m_size; ++i) {
+		m_slots[i].busy = false;
+		m_slots[i].client.connect(host, port);
+	}
+}
+
+ClientPool::~ClientPool() {
+	for(size_t i = 0; i < m_size; ++i) {
+		m_slots[i].client.disconnect();
+	}
+}
+
+bool
+ClientPool::claim(size_t slot) {
+
+	bool expected = false;
+	return !m_slots[slot].busy.load(memory_order_relaxed) &&
+		m_slots[slot].busy.compare_exchange_strong(expected, true, memory_order_acquire);
+}
+
+/**
+ * Returns a connection for the exclusive use of the caller, waiting for
+ * one to be released if they are all checked out. A broken connection is
+ * reopened before being handed out.
+ */
+ClientPool::Handle
+ClientPool::checkout() {
+
+	size_t slot = m_size;
+	if(t_last_pool == m_id && claim(t_last_slot)) {
+		slot = t_last_slot;
+		m_affinity_hits.fetch_add(1, memory_order_relaxed);
+	}
+
+	chrono::steady_clock::time_point wait_start;
+	bool waited = false;
+	while(slot == m_size) {
+		size_t start = m_next.fetch_add(1, memory_order_relaxed);
+		for(size_t i = 0; i < m_size; ++i) {
+			if(claim((start + i) % m_size)) {
+				slot = (start + i) % m_size;
+				break;
+			}
+		}
+		if(slot == m_size) { // all busy
+			if(!waited) {
+				waited = true;
+				wait_start = chrono::steady_clock::now();
+			}
+			this_thread::yield();
+		}
+	}
+
+	if(waited) {
+		chrono::nanoseconds ns = chrono::steady_clock::now() - wait_start;
+		m_waits.fetch_add(1, memory_order_relaxed);
+		m_wait_ns.fetch_add(ns.count(), memory_order_relaxed);
+	}
+
+	Client &c = m_slots[slot].client;
+	if(!c.connected() && c.reconnect()) {
+		m_replaced.fetch_add(1, memory_order_relaxed);
+	}
+
+	t_last_pool = m_id;
+	t_last_slot = slot;
+	m_checkouts.fetch_add(1, memory_order_relaxed);
+	m_in_use.fetch_add(1, memory_order_relaxed);
+	return Handle(this, slot);
+}
+
+void
+ClientPool::checkin(size_t slot) {
+
+	Client &c = m_slots[slot].client;
+	if(c.m_multi || c.m_pipeline) { // don't leak a transaction to the next user.
+		c.discard();
+	}
+
+	m_in_use.fetch_sub(1, memory_order_relaxed);
+	m_slots[slot].busy.store(false, memory_order_release);
+}
+
+ClientPool::Stats
+ClientPool::stats() const {
+
+	Stats s;
+	s.checkouts = m_checkouts.load(memory_order_relaxed);
+	s.affinity_hits = m_affinity_hits.load(memory_order_relaxed);
+	s.waits = m_waits.load(memory_order_relaxed);
+	s.wait_ns = m_wait_ns.load(memory_order_relaxed);
+	s.replaced = m_replaced.load(memory_order_relaxed);
+	s.in_use = m_in_use.load(memory_order_relaxed);
+	s.size = m_size;
+	return s;
+}
+
+size_t
+ClientPool::size() const {
+	return m_size;
+}
+
+/* Handle */
+
+ClientPool::Handle::Handle(ClientPool *pool, size_t slot) :
+	m_pool(pool),
+	m_slot(slot) {
+}
+
+ClientPool::Handle::Handle(Handle &&h) :
+	m_pool(h.m_pool),
+	m_slot(h.m_slot) {
+	h.m_pool = 0;
+}
+
+ClientPool::Handle &
+ClientPool::Handle::operator=(Handle &&h) {
+	if(this != &h) {
+		release();
+		m_pool = h.m_pool;
+		m_slot = h.m_slot;
+		h.m_pool = 0;
+	}
+	return *this;
+}
+
+ClientPool::Handle::~Handle() {
+	release();
+}
+
+Client &
+ClientPool::Handle::operator*() {
+	return m_pool->m_slots[m_slot].client;
+}
+
+Client *
+ClientPool::Handle::operator->() {
+	return &m_pool->m_slots[m_slot].client;
+}
+
+/**
+ * Gives the connection back to the pool; the handle can't be used anymore.
+ */
+void
+ClientPool::Handle::release() {
+	if(m_pool) {
+		m_pool->checkin(m_slot);
+		m_pool = 0;
+	}
+}
+
+}
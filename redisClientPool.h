@@ -0,0 +1,86 @@
+#ifndef REDIS_CLIENT_POOL_H
+#define REDIS_CLIENT_POOL_H
+
+#include "redis.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace redis {
+
+/**
+ * A fixed set of connections shared between threads. checkout() hands out
+ * a Handle that owns one connection until it is destroyed; MULTI or
+ * pipeline state left on it is discarded when it comes back.
+ *
+ * Checkout is lock-free: a thread first tries the connection it used last,
+ * then scans the free map from a rotating position.
+ */
+class ClientPool {
+
+	struct Slot {
+		std::atomic<bool> busy;
+		Client client;
+	};
+
+public:
+	struct Stats {
+		uint64_t checkouts;	// successful checkouts
+		uint64_t affinity_hits;	// served by the thread's last connection
+		uint64_t waits;		// checkouts that found no free connection
+		uint64_t wait_ns;	// total time spent waiting
+		uint64_t replaced;	// broken connections reopened
+		size_t in_use;		// connections currently checked out
+		size_t size;
+	};
+
+	class Handle {
+	public:
+		Handle(Handle &&h);
+		Handle &operator=(Handle &&h);
+		~Handle();
+
+		Client &operator*();
+		Client *operator->();
+		void release();
+
+	private:
+		friend class ClientPool;
+		Handle(ClientPool *pool, size_t slot);
+		Handle(const Handle &) = delete;
+		Handle &operator=(const Handle &) = delete;
+
+		ClientPool *m_pool;
+		size_t m_slot;
+	};
+
+	ClientPool(size_t size, std::string host = "127.0.0.1", short port = 6379);
+	~ClientPool();
+
+	Handle checkout();
+	Stats stats() const;
+	size_t size() const;
+
+private:
+	ClientPool(const ClientPool &) = delete;
+	ClientPool &operator=(const ClientPool &) = delete;
+
+	bool claim(size_t slot);
+	void checkin(size_t slot);
+
+	std::unique_ptr<Slot[]> m_slots;
+	size_t m_size;
+	uint64_t m_id;
+	std::atomic<size_t> m_next;
+
+	std::atomic<uint64_t> m_checkouts;
+	std::atomic<uint64_t> m_affinity_hits;
+	std::atomic<uint64_t> m_waits;
+	std::atomic<uint64_t> m_wait_ns;
+	std::atomic<uint64_t> m_replaced;
+	std::atomic<size_t> m_in_use;
+};
+}
+
+#endif /* REDIS_CLIENT_POOL_H */
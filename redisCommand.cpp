@@ -1,93 +1,334 @@
 #include "redisCommand.h"
 
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
 #include <string.h>
 
 using namespace std;
 
 namespace redis {
 
-Command::Command(string keyword) {
-	
-	Buffer s;
-	s.insert(s.end(), keyword.begin(), keyword.end());
-	m_elements.push_back(s);
+// room for any long, and for any double written in its shortest form.
+static const size_t NUMBER_MAX = 32;
+
+// arguments at least this large are referenced instead of copied.
+static const size_t REF_MIN = 1024;
+
+/**
+ * Formats a protocol header such as $42\r\n into buf, returning its size.
+ */
+static size_t
+format_header(char *buf, char type, size_t n) {
+
+	char *p = buf;
+	*p++ = type;
+	p = to_chars(p, p + NUMBER_MAX - 3, n).ptr;
+	*p++ = '\r';
+	*p++ = '\n';
+	return p - buf;
+}
+
+Command::Command(const Keyword &keyword) :
+	m_data(m_inline),
+	m_size(HEADROOM),
+	m_count(1),
+	m_start(HEADROOM),
+	m_trailer_size(0) {
+
+	write(keyword.data(), keyword.size());
+}
+
+Command::Command() :
+	m_data(m_inline),
+	m_size(HEADROOM),
+	m_count(0),
+	m_start(HEADROOM),
+	m_trailer_size(0) {
+}
+
+Command::Command(const Command &c) :
+	m_heap(c.m_heap),
+	m_data(m_heap.empty() ? m_inline : &m_heap[0]),
+	m_size(c.m_size),
+	m_count(c.m_count),
+	m_refs(c.m_refs),
+	m_start(HEADROOM),
+	m_trailer_size(0) {
+
+	if(m_heap.empty()) {
+		::memcpy(m_inline, c.m_inline, m_size);
+	}
+}
+
+/**
+ * Appends raw bytes to the frame, moving it to the heap if it outgrows the
+ * inline storage.
+ */
+void
+Command::write(const char *data, size_t sz) {
+
+	if(m_data == m_inline && m_size + sz > INLINE_SIZE) {
+		m_heap.resize(max(2 * INLINE_SIZE, m_size + sz));
+		::memcpy(&m_heap[0], m_inline, m_size);
+		m_data = &m_heap[0];
+	} else if(m_data != m_inline && m_size + sz > m_heap.size()) {
+		m_heap.resize(max(2 * m_heap.size(), m_size + sz));
+		m_data = &m_heap[0];
+	}
+	::memcpy(m_data + m_size, data, sz);
+	m_size += sz;
+}
+
+void
+Command::header(char type, size_t n) {
+
+	char tmp[NUMBER_MAX];
+	write(tmp, format_header(tmp, type, n));
+}
+
+void
+Command::arg(const char *data, size_t sz) {
+
+	header('$', sz);
+	write(data, sz);
+	write("\r\n", 2);
+	m_count++;
 }
 
 Command &
-Command::operator<<(const Buffer s) {
-	m_elements.push_back(s);
+Command::operator<<(const char *s) {
 
+	arg(s, strlen(s));
 	return *this;
 }
 
-// TODO: refactor the operator<< for numeric types.
-Command&
-Command::operator<<(long l) {
+Command &
+Command::operator<<(BufferRef s) {
 
-	// copy long value into a string stream
-	stringstream ss;
-	ss << l;
-	string str = ss.str();
+	if(s.size() < REF_MIN) {
+		arg(s.data(), s.size());
+		return *this;
+	}
 
-	// copy string stream into a char* buffer
-	Buffer s;
-	s.insert(s.end(), str.begin(), str.end());
+	header('$', s.size());
+	m_refs.push_back(make_pair(m_size, s));
+	write("\r\n", 2);
+	m_count++;
+	return *this;
+}
 
-	// add to the list of elements
-	m_elements.push_back(s);
+Command&
+Command::operator<<(long l) {
+
+	char tmp[NUMBER_MAX];
+	char *end = to_chars(tmp, tmp + sizeof(tmp), l).ptr;
+	arg(tmp, end - tmp);
 
 	return *this;
 }
 
+/**
+ * Doubles are written in the shortest form that reads back as the same
+ * value, e.g. 0.1 and not 0.10000000000000001, nor 6 digits only.
+ */
 Command&
 Command::operator<<(double d) {
 
-	// copy long value into a string stream
-	stringstream ss;
-	ss << d;
-	string str = ss.str();
+	char tmp[NUMBER_MAX];
+	char *end = to_chars(tmp, tmp + sizeof(tmp), d).ptr;
+	arg(tmp, end - tmp);
+
+	return *this;
+}
+
+/**
+ * Describes the frame with up to count iovecs, and returns how many it
+ * takes: one, plus two per referenced argument.
+ *
+ * With a payload size, the frame announces one more argument of that size
+ * and ends with its header: the caller sends the payload and its CRLF.
+ */
+size_t
+Command::get(struct iovec *iov, size_t count, long payload) {
+
+	// the argument count goes right before the arguments.
+	char tmp[NUMBER_MAX];
+	size_t n = format_header(tmp, '*', m_count + (payload >= 0));
+	m_start = HEADROOM - n;
+	::memcpy(m_data + m_start, tmp, n);
+
+	m_trailer_size = 0;
+	if(payload >= 0) {
+		m_trailer_size = format_header(m_trailer, '$', payload);
+	}
+
+	size_t needed = 1 + 2 * m_refs.size() + (m_trailer_size ? 1 : 0);
+	if(needed > count) {
+		return needed;
+	}
+
+	size_t pos = m_start;
+	vector<pair<size_t, BufferRef> >::const_iterator r;
+	for(r = m_refs.begin(); r != m_refs.end(); r++) {
+		iov->iov_base = m_data + pos;
+		iov->iov_len = r->first - pos;
+		iov++;
+		iov->iov_base = (void*)r->second.data();
+		iov->iov_len = r->second.size();
+		iov++;
+		pos = r->first;
+	}
+	iov->iov_base = m_data + pos;
+	iov->iov_len = m_size - pos;
+	if(m_trailer_size) {
+		iov++;
+		iov->iov_base = m_trailer;
+		iov->iov_len = m_trailer_size;
+	}
+	return needed;
+}
+
+/**
+ * Copies the whole frame at the end of out.
+ */
+void
+Command::append_to(Buffer &out) {
+
+	struct iovec small[8];
+	vector<struct iovec> large;
+	struct iovec *iov = small;
+
+	size_t n = get(small, 8);
+	if(n > 8) {
+		large.resize(n);
+		iov = &large[0];
+		get(iov, n);
+	}
+
+	for(size_t i = 0; i < n; ++i) {
+		const char *p = (const char*)iov[i].iov_base;
+		out.insert(out.end(), p, p + iov[i].iov_len);
+	}
+}
+
+PreparedCommand::PreparedCommand(const Keyword &keyword) :
+	m_segments(1),
+	m_count(1) {
+
+	m_segments[0].assign(keyword.data(), keyword.data() + keyword.size());
+	count_changed();
+}
 
-	// copy string stream into a char* buffer
-	Buffer s;
-	s.insert(s.end(), str.begin(), str.end());
+void
+PreparedCommand::count_changed() {
 
-	// add to the list of elements
-	m_elements.push_back(s);
+	m_prefix.resize(NUMBER_MAX);
+	m_prefix.resize(format_header(&m_prefix[0], '*', m_count));
+}
+
+void
+PreparedCommand::arg(const char *data, size_t sz) {
+
+	char tmp[NUMBER_MAX];
+	Buffer &seg = m_segments.back();
+	seg.insert(seg.end(), tmp, tmp + format_header(tmp, '$', sz));
+	seg.insert(seg.end(), data, data + sz);
+	seg.push_back('\r');
+	seg.push_back('\n');
+
+	m_count++;
+	count_changed();
+}
 
+PreparedCommand &
+PreparedCommand::operator<<(const char *s) {
+	arg(s, strlen(s));
 	return *this;
 }
 
-Buffer
-Command::get() {
+PreparedCommand &
+PreparedCommand::operator<<(BufferRef s) {
+	arg(s.data(), s.size());
+	return *this;
+}
 
-	Buffer ret;
+PreparedCommand &
+PreparedCommand::operator<<(long l) {
 
-	stringstream ss_count;
-	ss_count << "*" << m_elements.size() << "\r\n";
-	string str_count = ss_count.str();
+	char tmp[NUMBER_MAX];
+	arg(tmp, to_chars(tmp, tmp + sizeof(tmp), l).ptr - tmp);
+	return *this;
+}
 
-	// add header line to return buffer.
-	ret.insert(ret.end(), str_count.begin(), str_count.end());
+PreparedCommand &
+PreparedCommand::operator<<(double d) {
 
+	char tmp[NUMBER_MAX];
+	arg(tmp, to_chars(tmp, tmp + sizeof(tmp), d).ptr - tmp);
+	return *this;
+}
 
-	// add each element, preceded by its size.
-	list<Buffer>::const_iterator i;
-	for(i = m_elements.begin(); i != m_elements.end(); i++) {
-		// add "size" size followed by \r\n
-		stringstream ss_size;
-		ss_size << "$" << i->size() << "\r\n";
-		string ss_str = ss_size.str();
-		ret.insert(ret.end(), ss_str.begin(), ss_str.end());
-		
-		// add element, followed by CRLF.
-		ret.insert(ret.end(), i->begin(), i->end());
-		ret.push_back('\r');
-		ret.push_back('\n');
-	}
+/**
+ * Adds a placeholder for an argument given at each execution.
+ */
+PreparedCommand &
+PreparedCommand::param() {
 
-	return ret;
+	m_count++;
+	m_segments.push_back(Buffer());
+	count_changed();
+	return *this;
 }
+
+size_t
+PreparedCommand::params() const {
+	return m_segments.size() - 1;
 }
 
+/**
+ * Builds a command from the precomputed segments and the values of the
+ * params, in order. Large values are referenced and must outlive it.
+ * Throws invalid_argument unless there is one value per param.
+ */
+Command
+PreparedCommand::bind(const vector<Buffer> &values) const {
+
+	if(values.size() != params()) {
+		throw invalid_argument("PreparedCommand::bind");
+	}
+	Command cmd;
+	cmd.m_count = m_count - values.size();
+	for(size_t i = 0; i < m_segments.size(); ++i) {
+		if(i) {
+			cmd << values[i - 1];
+		}
+		cmd.write(m_segments[i].data(), m_segments[i].size());
+	}
+	return cmd;
+}
+
+/**
+ * Encodes one execution straight at the end of out, e.g. a pipeline.
+ * Throws invalid_argument unless there is one value per param.
+ */
+void
+PreparedCommand::append_to(Buffer &out, const vector<Buffer> &values) const {
+
+	if(values.size() != params()) {
+		throw invalid_argument("PreparedCommand::append_to");
+	}
+	char tmp[NUMBER_MAX];
+	out.insert(out.end(), m_prefix.begin(), m_prefix.end());
+	for(size_t i = 0; i < m_segments.size(); ++i) {
+		if(i) {
+			const Buffer &v = values[i - 1];
+			out.insert(out.end(), tmp, tmp + format_header(tmp, '$', v.size()));
+			out.insert(out.end(), v.begin(), v.end());
+			out.push_back('\r');
+			out.push_back('\n');
+		}
+		out.insert(out.end(), m_segments[i].begin(), m_segments[i].end());
+	}
+}
+}
@@ -2,30 +2,137 @@
 #define REDIS_COMMAND_H
 
 #include "redisBuffer.h"
+#include <sys/uio.h>
 #include <list>
-#include <map>
 #include <string>
 #include <vector>
 
 
 namespace redis {
 
-typedef std::map<Buffer, Buffer> RedisMap;
+/**
+ * A command name with its protocol header, $3\r\nSET\r\n, built at compile
+ * time from a string literal.
+ */
+class Keyword {
 
+public:
+	template <size_t N>
+	consteval Keyword(const char (&name)[N]) :
+		m_frame(),
+		m_size(0) {
+
+		static_assert(N < sizeof(m_frame) - 8, "keyword too long");
+
+		char digits[4];
+		size_t nd = 0, len = N - 1;
+		do {
+			digits[nd++] = '0' + len % 10;
+			len /= 10;
+		} while(len);
+
+		m_frame[m_size++] = '$';
+		while(nd) {
+			m_frame[m_size++] = digits[--nd];
+		}
+		m_frame[m_size++] = '\r';
+		m_frame[m_size++] = '\n';
+		for(size_t i = 0; i < N - 1; ++i) {
+			m_frame[m_size++] = name[i];
+		}
+		m_frame[m_size++] = '\r';
+		m_frame[m_size++] = '\n';
+	}
+
+	const char *data() const { return m_frame; }
+	size_t size() const { return m_size; }
+
+private:
+	char m_frame[40];
+	size_t m_size;
+};
+
+/**
+ * Encodes a command in one pass as its arguments are added. Frames of
+ * typical commands fit in inline storage, without any allocation. Large
+ * arguments are not copied but referenced: they must outlive the command.
+ */
 class Command {
 
 public:
-	Command(std::string keyword);
+	Command(const Keyword &keyword);
+	Command(const Command &c);
+	Command &operator=(const Command &) = delete;
 
 	Command &operator<<(const char *s);
 	Command &operator<<(long l);
 	Command &operator<<(double d);
-	Command &operator<<(const Buffer s);
+	Command &operator<<(BufferRef s);
 
-	Buffer get();
+	size_t get(struct iovec *iov, size_t count, long payload = -1);
+	void append_to(Buffer &out);
 
 private:
-	std::list<Buffer> m_elements;
+	friend class PreparedCommand;
+	Command();
+
+	void write(const char *data, size_t sz);
+	void header(char type, size_t n);
+	void arg(const char *data, size_t sz);
+
+	// room left in front of the arguments for *N\r\n.
+	static const size_t HEADROOM = 24;
+	static const size_t INLINE_SIZE = 256;
+
+	char m_inline[INLINE_SIZE];
+	std::vector<char> m_heap; // once the frame outgrows m_inline
+	char *m_data;
+	size_t m_size;
+	size_t m_count;
+
+	// large arguments, to be sent from where they are after the frame's
+	// first `offset` bytes.
+	std::vector<std::pair<size_t, BufferRef> > m_refs;
+
+	// *N\r\n and the header of a trailing payload, written by get().
+	size_t m_start;
+	char m_trailer[24];
+	size_t m_trailer_size;
+};
+
+/**
+ * A command whose fixed arguments are encoded once, with placeholders for
+ * the ones that change at each execution:
+ *
+ *     PreparedCommand hset("HSET");
+ *     hset.param() << "field";
+ *     hset.param();
+ *     c.execute(hset, {"user:42", "value"});
+ *
+ * Executing it only encodes the values, between the precomputed segments.
+ */
+class PreparedCommand {
+
+public:
+	PreparedCommand(const Keyword &keyword);
+
+	PreparedCommand &operator<<(const char *s);
+	PreparedCommand &operator<<(long l);
+	PreparedCommand &operator<<(double d);
+	PreparedCommand &operator<<(BufferRef s);
+	PreparedCommand &param();
+
+	size_t params() const;
+	Command bind(const std::vector<Buffer> &values) const;
+	void append_to(Buffer &out, const std::vector<Buffer> &values) const;
+
+private:
+	void arg(const char *data, size_t sz);
+	void count_changed();
+
+	std::vector<Buffer> m_segments; // one more than there are params
+	size_t m_count;
+	Buffer m_prefix; // *N\r\n
 };
 }
 
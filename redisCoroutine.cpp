@@ -0,0 +1,221 @@
+#include "redisCoroutine.h"
+
+using namespace std;
+
+namespace redis {
+
+CoClient::CoClient(Client &c) :
+	m_client(c) {
+}
+
+Client &
+CoClient::client() {
+	return m_client;
+}
+
+Awaiter
+CoClient::ping() {
+	return Awaiter(m_client, [&](Client &c) { return c.ping(); });
+}
+
+Awaiter
+CoClient::get(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.get(key); });
+}
+
+Awaiter
+CoClient::set(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.set(key, val); });
+}
+
+Awaiter
+CoClient::getset(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.getset(key, val); });
+}
+
+Awaiter
+CoClient::setnx(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.setnx(key, val); });
+}
+
+Awaiter
+CoClient::incr(BufferRef key, int val) {
+	return Awaiter(m_client, [&](Client &c) { return c.incr(key, val); });
+}
+
+Awaiter
+CoClient::decr(BufferRef key, int val) {
+	return Awaiter(m_client, [&](Client &c) { return c.decr(key, val); });
+}
+
+Awaiter
+CoClient::del(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.del(key); });
+}
+
+Awaiter
+CoClient::del(const List &keys) {
+	return Awaiter(m_client, [&](Client &c) { return c.del(keys); });
+}
+
+Awaiter
+CoClient::exists(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.exists(key); });
+}
+
+Awaiter
+CoClient::expire(BufferRef key, long ttl) {
+	return Awaiter(m_client, [&](Client &c) { return c.expire(key, ttl); });
+}
+
+Awaiter
+CoClient::ttl(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.ttl(key); });
+}
+
+Awaiter
+CoClient::mget(const List &keys) {
+	return Awaiter(m_client, [&](Client &c) { return c.mget(keys); });
+}
+
+Awaiter
+CoClient::mset(const List &keys, const List &vals) {
+	return Awaiter(m_client, [&](Client &c) { return c.mset(keys, vals); });
+}
+
+Awaiter
+CoClient::lpush(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.lpush(key, val); });
+}
+
+Awaiter
+CoClient::rpush(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.rpush(key, val); });
+}
+
+Awaiter
+CoClient::lpop(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.lpop(key); });
+}
+
+Awaiter
+CoClient::rpop(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.rpop(key); });
+}
+
+Awaiter
+CoClient::llen(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.llen(key); });
+}
+
+Awaiter
+CoClient::lrange(BufferRef key, int start, int end) {
+	return Awaiter(m_client, [&](Client &c) { return c.lrange(key, start, end); });
+}
+
+Awaiter
+CoClient::sadd(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.sadd(key, val); });
+}
+
+Awaiter
+CoClient::srem(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.srem(key, val); });
+}
+
+Awaiter
+CoClient::sismember(BufferRef key, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.sismember(key, val); });
+}
+
+Awaiter
+CoClient::smembers(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.smembers(key); });
+}
+
+Awaiter
+CoClient::scard(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.scard(key); });
+}
+
+Awaiter
+CoClient::zadd(BufferRef key, double score, BufferRef member) {
+	return Awaiter(m_client, [&](Client &c) { return c.zadd(key, score, member); });
+}
+
+Awaiter
+CoClient::zrem(BufferRef key, BufferRef member) {
+	return Awaiter(m_client, [&](Client &c) { return c.zrem(key, member); });
+}
+
+Awaiter
+CoClient::zincrby(BufferRef key, double score, BufferRef member) {
+	return Awaiter(m_client, [&](Client &c) { return c.zincrby(key, score, member); });
+}
+
+Awaiter
+CoClient::zscore(BufferRef key, BufferRef member) {
+	return Awaiter(m_client, [&](Client &c) { return c.zscore(key, member); });
+}
+
+Awaiter
+CoClient::zrank(BufferRef key, BufferRef member) {
+	return Awaiter(m_client, [&](Client &c) { return c.zrank(key, member); });
+}
+
+Awaiter
+CoClient::zcard(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.zcard(key); });
+}
+
+Awaiter
+CoClient::zrange(BufferRef key, long start, long end, bool withscores) {
+	return Awaiter(m_client, [&](Client &c) { return c.zrange(key, start, end, withscores); });
+}
+
+Awaiter
+CoClient::zrevrange(BufferRef key, long start, long end, bool withscores) {
+	return Awaiter(m_client, [&](Client &c) { return c.zrevrange(key, start, end, withscores); });
+}
+
+Awaiter
+CoClient::zrangebyscore(BufferRef key, long min, long max, bool withscores) {
+	return Awaiter(m_client, [&](Client &c) { return c.zrangebyscore(key, min, max, withscores); });
+}
+
+Awaiter
+CoClient::hset(BufferRef key, BufferRef field, BufferRef val) {
+	return Awaiter(m_client, [&](Client &c) { return c.hset(key, field, val); });
+}
+
+Awaiter
+CoClient::hget(BufferRef key, BufferRef field) {
+	return Awaiter(m_client, [&](Client &c) { return c.hget(key, field); });
+}
+
+Awaiter
+CoClient::hdel(BufferRef key, BufferRef field) {
+	return Awaiter(m_client, [&](Client &c) { return c.hdel(key, field); });
+}
+
+Awaiter
+CoClient::hexists(BufferRef key, BufferRef field) {
+	return Awaiter(m_client, [&](Client &c) { return c.hexists(key, field); });
+}
+
+Awaiter
+CoClient::hlen(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.hlen(key); });
+}
+
+Awaiter
+CoClient::hgetall(BufferRef key) {
+	return Awaiter(m_client, [&](Client &c) { return c.hgetall(key); });
+}
+
+Awaiter
+CoClient::hincrby(BufferRef key, BufferRef field, double d) {
+	return Awaiter(m_client, [&](Client &c) { return c.hincrby(key, field, d); });
+}
+
+}
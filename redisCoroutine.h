@@ -0,0 +1,170 @@
+#ifndef REDIS_COROUTINE_H
+#define REDIS_COROUTINE_H
+
+#include "redis.h"
+#include <coroutine>
+#include <exception>
+
+namespace redis {
+
+/**
+ * Awaits the reply of one command issued on a client attached to an
+ * EventLoop. The coroutine is resumed by the loop with the parsed reply.
+ * Awaiting allocates nothing: the awaiter lives in the coroutine frame and
+ * the command's callback only holds a pointer to it. An awaiter destroyed
+ * before its reply arrives clears that pointer, and the reply is ignored.
+ *
+ * Clients that are not attached to a loop run the command right away.
+ */
+class [[nodiscard]] Awaiter {
+
+	// small enough for std::function to hold it inline.
+	struct Resume {
+		Awaiter *awaiter;
+		void operator()(Response &r) const {
+			if(awaiter) {
+				awaiter->complete(r);
+			}
+		}
+	};
+
+public:
+	template <typename F>
+	Awaiter(Client &c, F issue) :
+		m_resp(REDIS_ERR),
+		m_done(false),
+		m_link(0) {
+
+		if(!c.m_loop) {
+			m_resp = issue(c);
+			m_done = true;
+			return;
+		}
+		size_t queued = c.m_pending.size();
+		Response r = issue(c.on_reply(Resume{this}));
+		if(r.type() != REDIS_QUEUED || c.m_pending.size() <= queued) { // no callback will come.
+			m_resp = r;
+			m_done = true;
+			return;
+		}
+		// entries of the deque stay in place until they are handled.
+		m_link = c.m_pending[queued].second.template target<Resume>();
+	}
+
+	~Awaiter() {
+		if(m_link) {
+			m_link->awaiter = 0;
+		}
+	}
+
+	Awaiter(const Awaiter &) = delete;
+	Awaiter &operator=(const Awaiter &) = delete;
+
+	bool await_ready() const { return m_done; }
+	void await_suspend(std::coroutine_handle<> h) { m_handle = h; }
+	Response await_resume() { return m_resp; }
+
+private:
+	void complete(Response &r) {
+		m_link = 0; // the callback is being called, and then destroyed.
+		m_resp = r;
+		m_done = true;
+		if(m_handle) {
+			m_handle.resume();
+		}
+	}
+
+	Response m_resp;
+	bool m_done;
+	std::coroutine_handle<> m_handle;
+	Resume *m_link; // our callback, while the client holds it
+};
+
+/**
+ * Awaitable versions of the Client commands:
+ *
+ *	redis::Response r = co_await cc.get("key");
+ *
+ * The client must be attached to an EventLoop. Any other command can be
+ * awaited with call(): co_await cc.call([&](Client &c) { return c.sort(k); });
+ * Arguments are only borrowed until the command is queued, as with Client.
+ */
+class CoClient {
+
+public:
+	CoClient(Client &c);
+
+	Client &client();
+
+	template <typename F>
+	Awaiter call(F issue) {
+		return Awaiter(m_client, issue);
+	}
+
+	Awaiter ping();
+	Awaiter get(BufferRef key);
+	Awaiter set(BufferRef key, BufferRef val);
+	Awaiter getset(BufferRef key, BufferRef val);
+	Awaiter setnx(BufferRef key, BufferRef val);
+	Awaiter incr(BufferRef key, int val = 1);
+	Awaiter decr(BufferRef key, int val = 1);
+	Awaiter del(BufferRef key);
+	Awaiter del(const List &keys);
+	Awaiter exists(BufferRef key);
+	Awaiter expire(BufferRef key, long ttl);
+	Awaiter ttl(BufferRef key);
+	Awaiter mget(const List &keys);
+	Awaiter mset(const List &keys, const List &vals);
+
+	Awaiter lpush(BufferRef key, BufferRef val);
+	Awaiter rpush(BufferRef key, BufferRef val);
+	Awaiter lpop(BufferRef key);
+	Awaiter rpop(BufferRef key);
+	Awaiter llen(BufferRef key);
+	Awaiter lrange(BufferRef key, int start, int end);
+
+	Awaiter sadd(BufferRef key, BufferRef val);
+	Awaiter srem(BufferRef key, BufferRef val);
+	Awaiter sismember(BufferRef key, BufferRef val);
+	Awaiter smembers(BufferRef key);
+	Awaiter scard(BufferRef key);
+
+	Awaiter zadd(BufferRef key, double score, BufferRef member);
+	Awaiter zrem(BufferRef key, BufferRef member);
+	Awaiter zincrby(BufferRef key, double score, BufferRef member);
+	Awaiter zscore(BufferRef key, BufferRef member);
+	Awaiter zrank(BufferRef key, BufferRef member);
+	Awaiter zcard(BufferRef key);
+	Awaiter zrange(BufferRef key, long start, long end, bool withscores = false);
+	Awaiter zrevrange(BufferRef key, long start, long end, bool withscores = false);
+	Awaiter zrangebyscore(BufferRef key, long min, long max, bool withscores = false);
+
+	Awaiter hset(BufferRef key, BufferRef field, BufferRef val);
+	Awaiter hget(BufferRef key, BufferRef field);
+	Awaiter hdel(BufferRef key, BufferRef field);
+	Awaiter hexists(BufferRef key, BufferRef field);
+	Awaiter hlen(BufferRef key);
+	Awaiter hgetall(BufferRef key);
+	Awaiter hincrby(BufferRef key, BufferRef field, double d);
+
+private:
+	Client &m_client;
+};
+
+/**
+ * Fire-and-forget coroutine type for request handlers:
+ * redis::Task handler(redis::CoClient &cc) { ... co_await cc.get(k); ... }
+ */
+struct Task {
+	struct promise_type {
+		Task get_return_object() { return Task(); }
+		std::suspend_never initial_suspend() { return std::suspend_never(); }
+		std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+}
+
+#endif /* REDIS_COROUTINE_H */
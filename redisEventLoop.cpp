@@ -0,0 +1,759 @@
+#include "redisEventLoop.h"
+#include "redis.h"
+
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef REDIS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+#endif
+
+using namespace std;
+
+namespace redis {
+
+// maximum number of events handled per call to epoll_wait.
+static const int MAX_EVENTS = 64;
+
+#ifdef REDIS_IO_URING
+
+// depth of the submission queue.
+static const unsigned RING_ENTRIES = 256;
+
+// receive buffers registered with the kernel, one per client while they last.
+static const unsigned RING_SLOTS = 64;
+static const size_t RING_SLOT_SIZE = 16384;
+
+// the low bits of each request's user_data tell what it was.
+enum { OP_RECV = 0, OP_SEND = 1, OP_CANCEL = 2, OP_MASK = 3 };
+
+/**
+ * io_uring backend: every client has at most one receive and one send in
+ * flight. Sends are batched until the next run_once(), which submits them
+ * and waits for completions in a single io_uring_enter(2).
+ */
+struct EventLoop::Ring {
+
+	/**
+	 * A client attached to the ring. Outlives its removal until the kernel
+	 * is done with its requests and buffers.
+	 */
+	struct Conn {
+		Conn(Client *c, int s) :
+			client(c),
+			fd(c->m_fd),
+			slot(s),
+			opos(0),
+			reading(false),
+			writing(false),
+			dirty(false),
+			busy(false),
+			closed(false) {
+		}
+
+		Client *client;
+		int fd;
+		int slot; // registered buffer, or -1 to receive into spare.
+		vector<char> spare;
+		Buffer out; // commands being sent, from opos on.
+		size_t opos;
+		bool reading;
+		bool writing;
+		bool dirty;
+		bool busy; // dispatching replies
+		bool closed;
+	};
+
+	Ring();
+	~Ring();
+	static Ring *create();
+
+	bool add(Client &c);
+	void remove(Client &c);
+	void want_send(Client &c);
+	int run_once(EventLoop &loop, int timeout);
+	bool idle() const;
+
+private:
+	bool queue(const struct io_uring_sqe &sqe);
+	int enter(bool wait, int timeout);
+	void reap();
+	void settle(Conn *conn);
+	void recv(Conn *conn);
+	void send(Conn *conn);
+	void cancel(Conn *conn, unsigned op);
+	void release(Conn *conn);
+	void complete(EventLoop &loop, Conn *conn, unsigned op, int res);
+
+	int m_fd;
+	struct io_uring_params m_params;
+	void *m_sq_ptr;
+	size_t m_sq_size;
+	void *m_cq_ptr;
+	size_t m_cq_size;
+	struct io_uring_sqe *m_sqes;
+	unsigned m_sq_tail;
+
+	char *m_buffers;
+	vector<int> m_free_slots;
+
+	map<Client*, Conn*> m_conns;
+	vector<Conn*> m_dirty;
+	deque<struct io_uring_cqe> m_cqes; // reaped, not yet handled
+
+	size_t m_alive; // attached and retired connections
+};
+
+EventLoop::Ring::Ring() :
+	m_fd(-1),
+	m_sq_ptr(MAP_FAILED),
+	m_sq_size(0),
+	m_cq_ptr(MAP_FAILED),
+	m_cq_size(0),
+	m_sqes((struct io_uring_sqe*)MAP_FAILED),
+	m_sq_tail(0),
+	m_buffers((char*)MAP_FAILED),
+	m_alive(0) {
+
+	memset(&m_params, 0, sizeof(m_params));
+}
+
+EventLoop::Ring::~Ring() {
+
+	if(m_buffers != MAP_FAILED) {
+		munmap(m_buffers, RING_SLOTS * RING_SLOT_SIZE);
+	}
+	if(m_sqes != MAP_FAILED) {
+		munmap(m_sqes, m_params.sq_entries * sizeof(struct io_uring_sqe));
+	}
+	if(m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr) {
+		munmap(m_cq_ptr, m_cq_size);
+	}
+	if(m_sq_ptr != MAP_FAILED) {
+		munmap(m_sq_ptr, m_sq_size);
+	}
+	if(m_fd != -1) {
+		close(m_fd);
+	}
+}
+
+/**
+ * Sets up a ring and its registered buffers. Returns 0 if the kernel lacks
+ * io_uring or the features we rely on (5.11 or later), or forbids it.
+ */
+EventLoop::Ring *
+EventLoop::Ring::create() {
+
+	Ring *r = new Ring;
+
+	r->m_params.flags = IORING_SETUP_COOP_TASKRUN;
+	r->m_fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &r->m_params);
+	if(r->m_fd == -1 && errno == EINVAL) { // before 5.19
+		memset(&r->m_params, 0, sizeof(r->m_params));
+		r->m_fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &r->m_params);
+	}
+
+	unsigned needed = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+	if(r->m_fd == -1 || (r->m_params.features & needed) != needed) {
+		delete r;
+		return 0;
+	}
+
+	struct io_uring_params &p = r->m_params;
+	r->m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->m_sq_size = r->m_cq_size = max(r->m_sq_size, r->m_cq_size);
+	}
+
+	r->m_sq_ptr = mmap(0, r->m_sq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->m_fd, IORING_OFF_SQ_RING);
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->m_cq_ptr = r->m_sq_ptr;
+	} else {
+		r->m_cq_ptr = mmap(0, r->m_cq_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, r->m_fd, IORING_OFF_CQ_RING);
+	}
+	r->m_sqes = (struct io_uring_sqe*)mmap(0, p.sq_entries * sizeof(struct io_uring_sqe),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->m_fd, IORING_OFF_SQES);
+	if(r->m_sq_ptr == MAP_FAILED || r->m_cq_ptr == MAP_FAILED || r->m_sqes == MAP_FAILED) {
+		delete r;
+		return 0;
+	}
+	r->m_sq_tail = *(unsigned*)((char*)r->m_sq_ptr + p.sq_off.tail);
+
+	// receive buffers; without them, clients receive into their own memory.
+	r->m_buffers = (char*)mmap(0, RING_SLOTS * RING_SLOT_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(r->m_buffers != MAP_FAILED) {
+		struct iovec iov[RING_SLOTS];
+		for(unsigned i = 0; i < RING_SLOTS; ++i) {
+			iov[i].iov_base = r->m_buffers + i * RING_SLOT_SIZE;
+			iov[i].iov_len = RING_SLOT_SIZE;
+		}
+		if(syscall(__NR_io_uring_register, r->m_fd, IORING_REGISTER_BUFFERS, iov, RING_SLOTS) == 0) {
+			for(unsigned i = RING_SLOTS; i > 0; --i) {
+				r->m_free_slots.push_back(i - 1);
+			}
+		} else {
+			munmap(r->m_buffers, RING_SLOTS * RING_SLOT_SIZE);
+			r->m_buffers = (char*)MAP_FAILED;
+		}
+	}
+	return r;
+}
+
+bool
+EventLoop::Ring::add(Client &c) {
+
+	int slot = -1;
+	if(!m_free_slots.empty()) {
+		slot = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+
+	Conn *conn = new Conn(&c, slot);
+	if(slot == -1) {
+		conn->spare.resize(RING_SLOT_SIZE);
+	}
+	m_conns[&c] = conn;
+	m_alive++;
+
+	recv(conn);
+	if(!conn->reading) {
+		remove(c);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Detaches a client. Its requests still in flight are cancelled, and we
+ * wait for them to end so that the socket is ours again when we return.
+ * Completions of other clients received meanwhile are kept for run_once().
+ */
+void
+EventLoop::Ring::remove(Client &c) {
+
+	map<Client*, Conn*>::iterator i = m_conns.find(&c);
+	if(i == m_conns.end()) {
+		return;
+	}
+	Conn *conn = i->second;
+	m_conns.erase(i);
+
+	conn->closed = true;
+	if(conn->reading && !conn->busy) {
+		cancel(conn, OP_RECV);
+	}
+	if(conn->writing) {
+		cancel(conn, OP_SEND);
+	}
+
+	settle(conn);
+	while((conn->reading && !conn->busy) || conn->writing) {
+		if(enter(true, -1) == -1 && errno != EINTR) {
+			break;
+		}
+		reap();
+		settle(conn);
+	}
+	release(conn);
+}
+
+/**
+ * Schedules the client's queued commands to be sent on the next run_once().
+ */
+void
+EventLoop::Ring::want_send(Client &c) {
+
+	map<Client*, Conn*>::iterator i = m_conns.find(&c);
+	if(i == m_conns.end()) {
+		return;
+	}
+	Conn *conn = i->second;
+	if(!conn->writing && !conn->dirty) {
+		conn->dirty = true;
+		m_dirty.push_back(conn);
+	}
+}
+
+bool
+EventLoop::Ring::idle() const {
+	return m_alive == 0;
+}
+
+/**
+ * Submits the sends scheduled since the last call along with any pending
+ * request, waits for completions and processes them. Returns the number of
+ * completions handled.
+ */
+int
+EventLoop::Ring::run_once(EventLoop &loop, int timeout) {
+
+	vector<Conn*> dirty;
+	dirty.swap(m_dirty);
+	for(vector<Conn*>::iterator i = dirty.begin(); i != dirty.end(); i++) {
+		(*i)->dirty = false;
+		if(!(*i)->writing) {
+			send(*i);
+		}
+	}
+
+	// don't block if completions are left over from remove().
+	if(enter(m_cqes.empty(), timeout) == -1 && errno != ETIME) {
+		return -1;
+	}
+	reap();
+
+	int handled = 0;
+	while(!m_cqes.empty()) {
+		struct io_uring_cqe cqe = m_cqes.front();
+		m_cqes.pop_front();
+
+		unsigned op = cqe.user_data & OP_MASK;
+		if(op == OP_CANCEL) {
+			continue;
+		}
+		complete(loop, (Conn*)(uintptr_t)(cqe.user_data & ~(uint64_t)OP_MASK), op, cqe.res);
+		handled++;
+	}
+	return handled;
+}
+
+/**
+ * Moves every completion available to m_cqes.
+ */
+void
+EventLoop::Ring::reap() {
+
+	char *cq = (char*)m_cq_ptr;
+	unsigned *khead = (unsigned*)(cq + m_params.cq_off.head);
+	unsigned *ktail = (unsigned*)(cq + m_params.cq_off.tail);
+	unsigned mask = *(unsigned*)(cq + m_params.cq_off.ring_mask);
+	struct io_uring_cqe *cqes = (struct io_uring_cqe*)(cq + m_params.cq_off.cqes);
+
+	unsigned head = *khead;
+	while(head != __atomic_load_n(ktail, __ATOMIC_ACQUIRE)) {
+		m_cqes.push_back(cqes[head & mask]);
+		__atomic_store_n(khead, ++head, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * Consumes the reaped completions of a removed connection's requests.
+ */
+void
+EventLoop::Ring::settle(Conn *conn) {
+
+	deque<struct io_uring_cqe>::iterator i = m_cqes.begin();
+	while(i != m_cqes.end()) {
+		unsigned op = i->user_data & OP_MASK;
+		if(op == OP_CANCEL || (Conn*)(uintptr_t)(i->user_data & ~(uint64_t)OP_MASK) != conn) {
+			i++;
+			continue;
+		}
+		if(op == OP_SEND) {
+			conn->writing = false;
+		} else {
+			conn->reading = false;
+		}
+		i = m_cqes.erase(i);
+	}
+}
+
+bool
+EventLoop::Ring::queue(const struct io_uring_sqe &sqe) {
+
+	char *sq = (char*)m_sq_ptr;
+	unsigned *khead = (unsigned*)(sq + m_params.sq_off.head);
+	unsigned *ktail = (unsigned*)(sq + m_params.sq_off.tail);
+	unsigned mask = *(unsigned*)(sq + m_params.sq_off.ring_mask);
+	unsigned *array = (unsigned*)(sq + m_params.sq_off.array);
+
+	if(m_sq_tail - __atomic_load_n(khead, __ATOMIC_ACQUIRE) == m_params.sq_entries) {
+		// full: submit what we have without waiting.
+		if(enter(false, 0) == -1 ||
+				m_sq_tail - __atomic_load_n(khead, __ATOMIC_ACQUIRE) == m_params.sq_entries) {
+			return false;
+		}
+	}
+
+	unsigned idx = m_sq_tail & mask;
+	m_sqes[idx] = sqe;
+	array[idx] = idx;
+	__atomic_store_n(ktail, ++m_sq_tail, __ATOMIC_RELEASE);
+	return true;
+}
+
+/**
+ * Submits the queued requests, and optionally waits for at least one
+ * completion for up to timeout milliseconds (forever if negative).
+ */
+int
+EventLoop::Ring::enter(bool wait, int timeout) {
+
+	unsigned *khead = (unsigned*)((char*)m_sq_ptr + m_params.sq_off.head);
+	unsigned to_submit = m_sq_tail - __atomic_load_n(khead, __ATOMIC_ACQUIRE);
+	unsigned flags = 0;
+
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	if(wait) {
+		flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+		if(timeout >= 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000L;
+			arg.ts = (uint64_t)(uintptr_t)&ts;
+		}
+	}
+
+	return syscall(__NR_io_uring_enter, m_fd, to_submit, wait ? 1 : 0, flags,
+			wait ? &arg : 0, wait ? sizeof(arg) : 0);
+}
+
+void
+EventLoop::Ring::recv(Conn *conn) {
+
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.fd = conn->fd;
+	sqe.user_data = (uint64_t)(uintptr_t)conn | OP_RECV;
+	if(conn->slot >= 0) {
+		sqe.opcode = IORING_OP_READ_FIXED;
+		sqe.addr = (uint64_t)(uintptr_t)(m_buffers + conn->slot * RING_SLOT_SIZE);
+		sqe.len = RING_SLOT_SIZE;
+		sqe.buf_index = conn->slot;
+	} else {
+		sqe.opcode = IORING_OP_RECV;
+		sqe.addr = (uint64_t)(uintptr_t)&conn->spare[0];
+		sqe.len = conn->spare.size();
+	}
+	conn->reading = queue(sqe);
+}
+
+/**
+ * Takes over the commands the client has queued and sends them.
+ */
+void
+EventLoop::Ring::send(Conn *conn) {
+
+	if(conn->out.empty()) {
+		conn->out.swap(conn->client->m_cmd);
+		conn->client->m_wpos = 0;
+		conn->opos = 0;
+	}
+	if(conn->out.empty()) {
+		return;
+	}
+
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_SEND;
+	sqe.fd = conn->fd;
+	sqe.addr = (uint64_t)(uintptr_t)&conn->out[conn->opos];
+	sqe.len = conn->out.size() - conn->opos;
+	sqe.msg_flags = MSG_NOSIGNAL;
+	sqe.user_data = (uint64_t)(uintptr_t)conn | OP_SEND;
+	conn->writing = queue(sqe);
+}
+
+void
+EventLoop::Ring::cancel(Conn *conn, unsigned op) {
+
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_ASYNC_CANCEL;
+	sqe.fd = -1;
+	sqe.addr = (uint64_t)(uintptr_t)conn | op;
+	sqe.user_data = OP_CANCEL;
+	queue(sqe);
+}
+
+/**
+ * Frees a removed connection once nothing refers to it anymore.
+ */
+void
+EventLoop::Ring::release(Conn *conn) {
+
+	if(!conn->closed || conn->reading || conn->writing || conn->busy) {
+		return;
+	}
+	if(conn->dirty) {
+		m_dirty.erase(find(m_dirty.begin(), m_dirty.end(), conn));
+	}
+	if(conn->slot >= 0) {
+		m_free_slots.push_back(conn->slot);
+	}
+	delete conn;
+	m_alive--;
+}
+
+void
+EventLoop::Ring::complete(EventLoop &loop, Conn *conn, unsigned op, int res) {
+
+	bool retry = (res == -EINTR || res == -EAGAIN);
+
+	if(op == OP_SEND) {
+		conn->writing = false;
+		if(conn->closed) {
+			release(conn);
+		} else if(retry) {
+			send(conn);
+		} else if(res < 0) {
+			loop.remove(*conn->client);
+		} else if((conn->opos += res) < conn->out.size()) {
+			send(conn); // partial write
+		} else {
+			conn->out.clear();
+			send(conn); // anything queued meanwhile
+		}
+		return;
+	}
+
+	if(conn->closed) {
+		conn->reading = false;
+		release(conn);
+		return;
+	}
+	if(retry) {
+		conn->reading = false;
+		recv(conn);
+		return;
+	}
+	if(res <= 0) {
+		conn->reading = false;
+		loop.remove(*conn->client);
+		return;
+	}
+
+	// callbacks may remove the client, keep the connection until we're done.
+	const char *data = conn->slot >= 0 ? m_buffers + conn->slot * RING_SLOT_SIZE : &conn->spare[0];
+	conn->busy = true;
+	conn->client->received(data, res);
+	bool ok = conn->client->dispatch();
+	conn->busy = false;
+	conn->reading = false;
+
+	if(conn->closed) {
+		release(conn);
+	} else if(ok) {
+		recv(conn);
+	} else {
+		loop.remove(*conn->client);
+	}
+}
+
+#endif
+
+EventLoop::EventLoop() :
+	m_epfd(-1),
+	m_running(false),
+	m_ring(0) {
+
+#ifdef REDIS_IO_URING
+	m_ring = Ring::create();
+#endif
+	if(!m_ring) {
+		m_epfd = epoll_create1(EPOLL_CLOEXEC);
+	}
+}
+
+EventLoop::~EventLoop() {
+
+	while(!m_clients.empty()) {
+		remove(**m_clients.begin());
+	}
+	if(m_epfd != -1) {
+		close(m_epfd);
+	}
+#ifdef REDIS_IO_URING
+	if(m_ring) {
+		// wait for the kernel to let go of our buffers.
+		while(!m_ring->idle() && m_ring->run_once(*this, -1) != -1) {
+		}
+		delete m_ring;
+	}
+#endif
+}
+
+/**
+ * Attaches a connected client to the loop, making its socket non-blocking.
+ */
+bool
+EventLoop::add(Client &c) {
+
+	if((m_epfd == -1 && !m_ring) || c.m_fd == -1 || c.m_loop || c.m_multi || c.m_pipeline) {
+		return false;
+	}
+	c.m_framer.reset();
+	c.m_framer.feed(&c.m_rbuf[c.m_rpos], c.m_rlen - c.m_rpos);
+
+#ifdef REDIS_IO_URING
+	if(m_ring) { // the socket stays blocking, the kernel polls it for us.
+		if(!m_ring->add(c)) {
+			return false;
+		}
+		c.m_loop = this;
+		m_clients.insert(&c);
+		return true;
+	}
+#endif
+
+	int flags = fcntl(c.m_fd, F_GETFL);
+	if(flags == -1 || fcntl(c.m_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		return false;
+	}
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &c;
+	if(epoll_ctl(m_epfd, EPOLL_CTL_ADD, c.m_fd, &ev) == -1) {
+		fcntl(c.m_fd, F_SETFL, flags);
+		return false;
+	}
+
+	c.m_loop = this;
+	m_clients.insert(&c);
+	return true;
+}
+
+/**
+ * Detaches a client and puts it back in blocking mode. Commands still
+ * waiting for a reply are failed.
+ */
+void
+EventLoop::remove(Client &c) {
+
+	if(c.m_loop != this) {
+		return;
+	}
+
+#ifdef REDIS_IO_URING
+	if(m_ring) {
+		m_ring->remove(c);
+	}
+#endif
+	if(m_epfd != -1) {
+		epoll_ctl(m_epfd, EPOLL_CTL_DEL, c.m_fd, 0);
+	}
+	int flags = fcntl(c.m_fd, F_GETFL);
+	if(flags != -1) {
+		fcntl(c.m_fd, F_SETFL, flags & ~O_NONBLOCK);
+	}
+
+	m_clients.erase(&c);
+	c.m_loop = 0;
+	c.fail_pending();
+}
+
+bool
+EventLoop::watch(Client &c, bool writable) {
+
+#ifdef REDIS_IO_URING
+	if(m_ring) {
+		if(writable) {
+			m_ring->want_send(c);
+		}
+		return true;
+	}
+#endif
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	if(writable) {
+		ev.events |= EPOLLOUT;
+	}
+	ev.data.ptr = &c;
+	return epoll_ctl(m_epfd, EPOLL_CTL_MOD, c.m_fd, &ev) == 0;
+}
+
+/**
+ * Waits for socket events and processes them, invoking the callbacks of
+ * every reply that has been received. Returns the number of events handled.
+ */
+int
+EventLoop::run_once(int timeout) {
+
+#ifdef REDIS_IO_URING
+	if(m_ring) {
+		return m_ring->run_once(*this, timeout);
+	}
+#endif
+
+	struct epoll_event events[MAX_EVENTS];
+
+	int n = epoll_wait(m_epfd, events, MAX_EVENTS, timeout);
+	for(int i = 0; i < n; ++i) {
+		Client *c = (Client*)events[i].data.ptr;
+		if(m_clients.find(c) == m_clients.end()) { // removed by a callback
+			continue;
+		}
+
+		bool ok = true;
+		if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+			ok = c->on_readable();
+		}
+		if(ok && (events[i].events & EPOLLOUT)) {
+			ok = c->on_writable();
+		}
+		if(!ok) {
+			remove(*c);
+		}
+	}
+	return n;
+}
+
+/**
+ * Runs until stop() is called or no command is waiting for a reply.
+ */
+void
+EventLoop::run() {
+
+	m_running = true;
+	while(m_running && pending()) {
+		if(run_once() == -1 && errno != EINTR) {
+			break;
+		}
+	}
+	m_running = false;
+}
+
+void
+EventLoop::stop() {
+	m_running = false;
+}
+
+size_t
+EventLoop::pending() const {
+
+	size_t count = 0;
+	set<Client*>::const_iterator i;
+	for(i = m_clients.begin(); i != m_clients.end(); i++) {
+		count += (*i)->m_pending.size();
+	}
+	return count;
+}
+
+/**
+ * Whether the loop runs on io_uring rather than epoll.
+ */
+bool
+EventLoop::uring() const {
+	return m_ring != 0;
+}
+
+}
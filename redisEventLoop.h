@@ -0,0 +1,50 @@
+#ifndef REDIS_EVENT_LOOP_H
+#define REDIS_EVENT_LOOP_H
+
+#include <set>
+#include <cstddef>
+
+namespace redis {
+class Client;
+
+/**
+ * Multiplexes the connections of several clients on one thread with epoll.
+ * Clients added to the loop switch to asynchronous mode: their commands are
+ * queued with a completion callback (see Client::on_reply) and written out,
+ * read and dispatched by the loop.
+ *
+ * When built with IO_URING=1 the loop drives all its sockets through a
+ * single io_uring instead, batching the sends and receives of every client
+ * in one system call per iteration. It falls back to epoll when the kernel
+ * does not support it.
+ */
+class EventLoop {
+
+public:
+	EventLoop();
+	~EventLoop();
+
+	bool add(Client &c);
+	void remove(Client &c);
+
+	int run_once(int timeout = -1);
+	void run();
+	void stop();
+
+	size_t pending() const;
+	bool uring() const;
+
+private:
+	friend class Client;
+	bool watch(Client &c, bool writable);
+
+	struct Ring;
+
+	int m_epfd;
+	bool m_running;
+	std::set<Client*> m_clients;
+	Ring *m_ring; // io_uring backend, if available.
+};
+}
+
+#endif /* REDIS_EVENT_LOOP_H */
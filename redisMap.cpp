@@ -0,0 +1,166 @@
+#include "redisMap.h"
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+namespace redis {
+
+RedisMap::RedisMap() {
+
+}
+
+/**
+ * Makes room for n entries, so that they can be inserted without rehashing.
+ */
+void
+RedisMap::reserve(size_t n) {
+
+	m_items.reserve(n);
+	if(2 * n > m_slots.size()) {
+		size_t sz = 16;
+		while(sz < 2 * n) {
+			sz *= 2;
+		}
+		m_slots.assign(sz, 0);
+		for(size_t i = 0; i < m_items.size(); ++i) {
+			m_slots[slot(m_items[i].first)] = i + 1;
+		}
+	}
+}
+
+/**
+ * Returns where key is in the table, or the free slot where it would go.
+ * The table is never more than half full.
+ */
+size_t
+RedisMap::slot(BufferRef key) const {
+
+	size_t mask = m_slots.size() - 1;
+	size_t i = hash<string_view>()(key) & mask;
+	while(m_slots[i] && m_items[m_slots[i] - 1].first != key) {
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+void
+RedisMap::grow() {
+	reserve(m_items.size() < 8 ? 8 : 2 * m_items.size());
+}
+
+/**
+ * As with std::map, inserting a key that is already there changes nothing.
+ * The key and value are moved in, with the memory resource they came with.
+ */
+pair<RedisMap::iterator, bool>
+RedisMap::insert(pair<Buffer, Buffer> v) {
+
+	if(2 * (m_items.size() + 1) > m_slots.size()) {
+		grow();
+	}
+	size_t i = slot(v.first);
+	if(m_slots[i]) {
+		return make_pair(iterator(m_items.data() + m_slots[i] - 1), false);
+	}
+	m_items.push_back(std::move(v));
+	m_slots[i] = m_items.size();
+	return make_pair(iterator(&m_items.back()), true);
+}
+
+Buffer &
+RedisMap::operator[](BufferRef key) {
+
+	if(2 * (m_items.size() + 1) > m_slots.size()) {
+		grow();
+	}
+	size_t i = slot(key);
+	if(!m_slots[i]) {
+		m_items.emplace_back(Buffer(string_view(key)), Buffer());
+		m_slots[i] = m_items.size();
+	}
+	return m_items[m_slots[i] - 1].second;
+}
+
+Buffer &
+RedisMap::at(BufferRef key) {
+
+	iterator i = find(key);
+	if(i == end()) {
+		throw out_of_range("RedisMap::at");
+	}
+	return i->second;
+}
+
+const Buffer &
+RedisMap::at(BufferRef key) const {
+
+	const_iterator i = find(key);
+	if(i == end()) {
+		throw out_of_range("RedisMap::at");
+	}
+	return i->second;
+}
+
+RedisMap::iterator
+RedisMap::find(BufferRef key) {
+	return iterator(m_items.data() + (static_cast<const RedisMap &>(*this).find(key).m_entry - m_items.data()));
+}
+
+RedisMap::const_iterator
+RedisMap::find(BufferRef key) const {
+
+	if(m_slots.empty()) {
+		return end();
+	}
+	size_t i = slot(key);
+	return m_slots[i] ? const_iterator(m_items.data() + m_slots[i] - 1) : end();
+}
+
+size_t
+RedisMap::count(BufferRef key) const {
+	return find(key) == end() ? 0 : 1;
+}
+
+size_t
+RedisMap::size() const {
+	return m_items.size();
+}
+
+bool
+RedisMap::empty() const {
+	return m_items.empty();
+}
+
+void
+RedisMap::clear() {
+	m_items.clear();
+	m_slots.clear();
+}
+
+void
+RedisMap::swap(RedisMap &m) {
+	m_items.swap(m.m_items);
+	m_slots.swap(m.m_slots);
+}
+
+RedisMap::iterator
+RedisMap::begin() {
+	return iterator(m_items.data());
+}
+
+RedisMap::iterator
+RedisMap::end() {
+	return iterator(m_items.data() + m_items.size());
+}
+
+RedisMap::const_iterator
+RedisMap::begin() const {
+	return const_iterator(m_items.data());
+}
+
+RedisMap::const_iterator
+RedisMap::end() const {
+	return const_iterator(m_items.data() + m_items.size());
+}
+}
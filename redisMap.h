@@ -0,0 +1,97 @@
+#ifndef REDIS_MAP_H
+#define REDIS_MAP_H
+
+#include "redisBuffer.h"
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace redis {
+
+/**
+ * Fields and values of a hash-shaped reply. Entries are stored in one
+ * vector in the order they were inserted, and found through an open
+ * addressing table of their positions.
+ *
+ * The calls are those of std::map, but iteration follows the order of
+ * insertion, i.e. the server's, rather than the order of the keys.
+ */
+class RedisMap {
+
+	typedef std::pair<Buffer, Buffer> Entry;
+
+	/**
+	 * Entries are stored with mutable keys, so that they are moved rather
+	 * than copied and keep the memory resource they were read into. The
+	 * iterators only give out const references to the keys, as std::map.
+	 */
+	template <typename E, typename V>
+	class Iterator {
+
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef std::ptrdiff_t difference_type;
+		typedef std::pair<const Buffer, Buffer> value_type;
+		typedef std::pair<const Buffer &, V &> reference;
+		struct pointer {
+			reference ref;
+			const reference *operator->() const { return &ref; }
+		};
+
+		Iterator() : m_entry(0) {}
+		explicit Iterator(E *e) : m_entry(e) {}
+		Iterator(const Iterator<Entry, Buffer> &i) : m_entry(i.m_entry) {}
+
+		reference operator*() const { return reference(m_entry->first, m_entry->second); }
+		pointer operator->() const { return pointer{**this}; }
+		Iterator &operator++() { ++m_entry; return *this; }
+		Iterator &operator--() { --m_entry; return *this; }
+		Iterator operator++(int) { Iterator i(*this); ++m_entry; return i; }
+		Iterator operator--(int) { Iterator i(*this); --m_entry; return i; }
+		bool operator==(const Iterator &i) const { return m_entry == i.m_entry; }
+
+	private:
+		friend class RedisMap;
+		friend class Iterator<const Entry, const Buffer>;
+		E *m_entry;
+	};
+
+public:
+	typedef Buffer key_type;
+	typedef Buffer mapped_type;
+	typedef std::pair<const Buffer, Buffer> value_type;
+	typedef Iterator<Entry, Buffer> iterator;
+	typedef Iterator<const Entry, const Buffer> const_iterator;
+
+	RedisMap();
+
+	void reserve(size_t n);
+	std::pair<iterator, bool> insert(std::pair<Buffer, Buffer> v);
+	Buffer &operator[](BufferRef key);
+
+	Buffer &at(BufferRef key);
+	const Buffer &at(BufferRef key) const;
+	iterator find(BufferRef key);
+	const_iterator find(BufferRef key) const;
+	size_t count(BufferRef key) const;
+
+	size_t size() const;
+	bool empty() const;
+	void clear();
+	void swap(RedisMap &m);
+	iterator begin();
+	iterator end();
+	const_iterator begin() const;
+	const_iterator end() const;
+
+private:
+	size_t slot(BufferRef key) const;
+	void grow();
+
+	std::vector<Entry> m_items;
+	std::vector<uint32_t> m_slots; // position + 1 in m_items, 0 if free
+};
+}
+
+#endif /* REDIS_MAP_H */
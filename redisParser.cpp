@@ -0,0 +1,214 @@
+#include "redisParser.h"
+#include "redisScan.h"
+
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace redis {
+
+// longest header line accepted, anything longer is a protocol error.
+static const size_t MAX_LINE = 65536;
+
+// payload room reserved for a bulk from its header alone. The length comes
+// from the wire, larger bulks grow as their data arrives.
+static const size_t BULK_RESERVE = 65536;
+
+Reply::Reply() :
+	type(0),
+	integer(0) {
+}
+
+Parser::Parser(bool keep) :
+	m_keep(keep),
+	m_failed(false),
+	m_bulk_left(-1),
+	m_ready(0) {
+}
+
+/**
+ * Consumes a chunk of the stream. Returns false on a protocol error, after
+ * which the parser stays failed until reset.
+ */
+bool
+Parser::feed(const char *data, size_t sz) {
+
+	while(sz && !m_failed) {
+		if(m_bulk_left >= 0) { // payload, then its CRLF
+			size_t n = (size_t)m_bulk_left < sz ? m_bulk_left : sz;
+			size_t payload = m_bulk.integer + 2 - m_bulk_left; // read so far
+			if(m_keep && payload < (size_t)m_bulk.integer) {
+				size_t copy = min(n, m_bulk.integer - payload);
+				m_bulk.str.insert(m_bulk.str.end(), data, data + copy);
+			}
+			data += n;
+			sz -= n;
+			if((m_bulk_left -= n) == 0) {
+				m_bulk_left = -1;
+				complete(m_bulk);
+			}
+			continue;
+		}
+
+		const char *nl = find_lf(data, sz);
+		if(!nl) { // keep the partial line for the next chunk.
+			m_line.append(data, sz);
+			m_failed = (m_line.size() > MAX_LINE);
+			break;
+		}
+
+		size_t n = nl + 1 - data;
+		if(m_line.empty()) {
+			line(data, n);
+		} else {
+			m_line.append(data, n);
+			line(m_line.data(), m_line.size());
+			m_line.clear();
+		}
+		data += n;
+		sz -= n;
+	}
+	return !m_failed;
+}
+
+/**
+ * Handles a header line, \r\n included.
+ */
+void
+Parser::line(const char *p, size_t sz) {
+
+	Reply r;
+	r.type = p[0];
+	size_t text = (sz >= 2 && p[sz - 2] == '\r') ? sz - 3 : sz - 2;
+
+	switch(r.type) {
+		case '+':
+		case '-':
+			if(m_keep) {
+				r.str.assign(p + 1, p + 1 + text);
+			}
+			complete(r);
+			return;
+
+		case ':':
+			r.integer = parse_long(p + 1, p + sz);
+			complete(r);
+			return;
+
+		case '$':
+			r.integer = parse_long(p + 1, p + sz);
+			if(r.integer < 0) { // nil
+				r.integer = -1;
+				complete(r);
+			} else {
+				if(m_keep) {
+					r.str.reserve(min((size_t)r.integer, BULK_RESERVE));
+				}
+				m_bulk = std::move(r);
+				m_bulk_left = m_bulk.integer + 2;
+			}
+			return;
+
+		case '*':
+			r.integer = parse_long(p + 1, p + sz);
+			if(r.integer <= 0) { // empty or nil
+				r.integer = r.integer < 0 ? -1 : 0;
+				complete(r);
+			} else {
+				m_stack.push_back(Frame());
+				m_stack.back().reply = r;
+				m_stack.back().remaining = r.integer;
+			}
+			return;
+	}
+	m_failed = true;
+}
+
+/**
+ * Adds a finished reply to the multi-bulk it belongs to, completing the
+ * enclosing ones in turn, or queues it if it is at the top level.
+ */
+void
+Parser::complete(Reply &r) {
+
+	Reply done = std::move(r);
+	while(!m_stack.empty()) {
+		Frame &f = m_stack.back();
+		if(m_keep) {
+			f.reply.elements.push_back(std::move(done));
+		}
+		if(--f.remaining) {
+			return;
+		}
+		done = std::move(f.reply);
+		m_stack.pop_back();
+	}
+
+	if(m_keep) {
+		m_done.push_back(std::move(done));
+	}
+	m_ready++;
+}
+
+/**
+ * Number of complete replies waiting to be taken.
+ */
+size_t
+Parser::ready() const {
+	return m_ready;
+}
+
+/**
+ * Takes the oldest complete reply.
+ */
+bool
+Parser::next(Reply &r) {
+
+	if(!m_ready || !m_keep) {
+		return false;
+	}
+	r = std::move(m_done.front());
+	m_done.pop_front();
+	m_ready--;
+	return true;
+}
+
+/**
+ * Drops the oldest complete reply.
+ */
+bool
+Parser::next() {
+
+	if(!m_ready) {
+		return false;
+	}
+	if(m_keep) {
+		m_done.pop_front();
+	}
+	m_ready--;
+	return true;
+}
+
+bool
+Parser::failed() const {
+	return m_failed;
+}
+
+/**
+ * Forgets everything, e.g. after reconnecting.
+ */
+void
+Parser::reset() {
+
+	m_failed = false;
+	m_line.clear();
+	m_bulk = Reply();
+	m_bulk_left = -1;
+	m_stack.clear();
+	m_done.clear();
+	m_ready = 0;
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef REDIS_PARSER_H
+#define REDIS_PARSER_H
+
+#include "redisBuffer.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace redis {
+
+/**
+ * A reply as sent by the server, before a command gives it a meaning.
+ * type is the RESP marker: '+' and '-' hold their line in str, ':' its
+ * value in integer, '$' its payload in str and '*' its elements. Bulks and
+ * multi-bulks also keep their announced length in integer, -1 for nil.
+ */
+struct Reply {
+	Reply();
+
+	char type;
+	long integer;
+	Buffer str;
+	std::vector<Reply> elements;
+};
+
+/**
+ * Incremental RESP parser: bytes are fed in chunks of any size, with the
+ * state (partial line, pending bulk length, nested multi-bulks) kept across
+ * calls. Completed replies are queued until taken with next().
+ *
+ * Without keep, replies are only framed: next() just drops them. This is
+ * how the event loop finds out which replies are complete.
+ */
+class Parser {
+
+public:
+	Parser(bool keep = true);
+
+	bool feed(const char *data, size_t sz);
+	size_t ready() const;
+	bool next(Reply &r);
+	bool next();
+
+	bool failed() const;
+	void reset();
+
+private:
+	void line(const char *p, size_t sz);
+	void complete(Reply &r);
+
+	// a multi-bulk being filled, with the number of elements still to come.
+	struct Frame {
+		Reply reply;
+		long remaining;
+	};
+
+	bool m_keep;
+	bool m_failed;
+	std::string m_line;	// header line split across chunks
+	Reply m_bulk;		// bulk whose payload is being read
+	long m_bulk_left;	// payload bytes and CRLF still to read, or -1
+	std::vector<Frame> m_stack;
+	std::deque<Reply> m_done;
+	size_t m_ready;
+};
+}
+
+#endif /* REDIS_PARSER_H */
@@ -0,0 +1,69 @@
+#include "redisReplyView.h"
+#include "redis.h"
+
+using namespace std;
+
+namespace redis {
+
+ReplyView::ReplyView() :
+	m_client(0),
+	m_gen(0),
+	m_type(REDIS_ERR),
+	m_long(0) {
+}
+
+ReplyView::~ReplyView() {
+	release();
+}
+
+/**
+ * Gives the slices back to the client, which may then reuse its buffer.
+ */
+void
+ReplyView::release() {
+
+	if(m_client) {
+		m_client->unpin(m_gen);
+		m_client = 0;
+	}
+	m_type = REDIS_ERR;
+	m_long = 0;
+	m_items.clear();
+}
+
+RedisResponseType
+ReplyView::type() const {
+	return m_type;
+}
+
+string_view
+ReplyView::str() const {
+	return m_items.empty() ? string_view() : m_items[0];
+}
+
+long
+ReplyView::integer() const {
+	return m_long;
+}
+
+size_t
+ReplyView::size() const {
+	return m_items.size();
+}
+
+string_view
+ReplyView::operator[](size_t i) const {
+	return m_items[i];
+}
+
+ReplyView::const_iterator
+ReplyView::begin() const {
+	return m_items.begin();
+}
+
+ReplyView::const_iterator
+ReplyView::end() const {
+	return m_items.end();
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef REDIS_REPLY_VIEW_H
+#define REDIS_REPLY_VIEW_H
+
+#include "redisResponse.h"
+#include <string_view>
+#include <vector>
+
+namespace redis {
+class Client;
+
+/**
+ * A reply read without copying: strings and list elements are slices of
+ * the client's receive buffer. They stay valid until the view is released
+ * or reused, which must happen before the client is destroyed.
+ *
+ * REDIS_STRING views have one element (bulk string or status line),
+ * REDIS_LIST views one per element, with a null slice for missing ones.
+ * REDIS_ERR views hold the error message, if the server sent one.
+ */
+class ReplyView {
+
+public:
+	typedef std::vector<std::string_view>::const_iterator const_iterator;
+
+	ReplyView();
+	~ReplyView();
+
+	ReplyView(const ReplyView &) = delete;
+	ReplyView &operator=(const ReplyView &) = delete;
+
+	void release();
+
+	RedisResponseType type() const;
+	std::string_view str() const;
+	long integer() const;
+
+	size_t size() const;
+	std::string_view operator[](size_t i) const;
+	const_iterator begin() const;
+	const_iterator end() const;
+
+private:
+	friend class Client;
+
+	Client *m_client; // pinned while we point into its buffer
+	size_t m_gen; // which of its buffers
+	RedisResponseType m_type;
+	long m_long;
+	std::vector<std::string_view> m_items;
+};
+}
+
+#endif /* REDIS_REPLY_VIEW_H */
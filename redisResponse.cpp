@@ -5,13 +5,68 @@ using namespace std;
 namespace redis {
 
 Response::Response(RedisResponseType t) :
+	m_type(t)
+{
+
+}
+
+/**
+ * A response whose strings may be allocated from arena.
+ */
+Response::Response(RedisResponseType t, const Arena &arena) :
 	m_type(t),
-	m_long(0),
-	m_bool(false)
+	m_arena(arena)
 {
 
 }
 
+Response::Response(const Response &r) :
+	m_type(r.m_type),
+	m_val(r.m_val)
+{
+
+}
+
+Response &
+Response::operator=(const Response &r) {
+
+	if(this == &r) {
+		return *this;
+	}
+	// drop our value first, it may live in our arena.
+	m_val = std::monostate();
+	m_val = r.m_val;
+	m_arena.reset();
+	m_type = r.m_type;
+	return *this;
+}
+
+Response &
+Response::operator=(Response &&r) {
+
+	if(this == &r) {
+		return *this;
+	}
+	// values are moved as a whole, never into strings of another arena.
+	m_val = std::monostate();
+	m_val = std::move(r.m_val);
+	m_arena = std::move(r.m_arena);
+	m_type = r.m_type;
+	return *this;
+}
+
+/**
+ * Returns the held T, replacing whatever else was held.
+ */
+template <typename T>
+T &
+Response::hold() {
+	if(!std::holds_alternative<T>(m_val)) {
+		m_val.emplace<T>();
+	}
+	return std::get<T>(m_val);
+}
+
 // generic setters
 template <>
 bool
@@ -20,7 +75,7 @@ Response::set<Buffer>(Buffer s) {
 		return false;
 	}
 
-	m_str = s;
+	m_val.emplace<Buffer>(std::move(s));
 	return true;
 }
 
@@ -31,7 +86,7 @@ Response::set<long>(long l) {
 		return false;
 	}
 
-	m_long = l;
+	hold<long>() = l;
 	return true;
 }
 
@@ -41,7 +96,7 @@ Response::set<bool>(bool b) {
 	if(m_type != REDIS_BOOL) {
 		return false;
 	}
-	m_bool = b;
+	hold<bool>() = b;
 	return true;
 }
 
@@ -51,7 +106,7 @@ Response::set<double>(double d) {
 	if(m_type != REDIS_DOUBLE) {
 		return false;
 	}
-	m_double = d;
+	hold<double>() = d;
 	return true;
 }
 
@@ -61,7 +116,7 @@ Response::addString(Buffer s) {
 		return false;
 	}
 
-	m_array.push_back(s);
+	hold<vector<Buffer> >().push_back(std::move(s));
 	return true;
 }
 
@@ -71,7 +126,7 @@ Response::addString(std::string key, std::string val) {
 		return false;
 	}
 
-	return addString(Buffer(key.c_str(), 1+key.size()), Buffer(val.c_str(), 1+val.size()));
+	return addString(Buffer(key), Buffer(val));
 }
 
 bool
@@ -80,7 +135,7 @@ Response::addString(Buffer key, Buffer val) {
 		return false;
 	}
 
-	m_map.insert(make_pair(key, val));
+	hold<RedisMap>().insert(make_pair(std::move(key), std::move(val)));
 	return true;
 }
 bool
@@ -89,7 +144,7 @@ Response::addZString(Buffer s, double score) {
 		return false;
 	}
 
-	m_zarray.push_back(make_pair(score, s));
+	hold<ZList>().push_back(make_pair(score, std::move(s)));
 	return true;
 }
 
@@ -105,63 +160,76 @@ Response::type() const {
 int
 Response::size() const {
 	if(m_type == REDIS_LIST) {
-		return m_array.size();
+		return ref<vector<Buffer> >().size();
 	} else if(m_type == REDIS_ZSET) {
-		return m_zarray.size();
+		return ref<ZList>().size();
 	} else if(m_type == REDIS_HASH) {
-		return m_map.size();
+		return ref<RedisMap>().size();
 	}
 	return -1;
 }
 
+/**
+ * Makes room for n elements in lists and maps.
+ */
+void
+Response::reserve(size_t n) {
+	if(m_type == REDIS_LIST) {
+		hold<vector<Buffer> >().reserve(n);
+	} else if(m_type == REDIS_HASH || m_type == REDIS_INFO_MAP) {
+		hold<RedisMap>().reserve(n);
+	}
+}
+
 // getters
 template <>
 long Response::get<long>() const {
-	return m_long;
+	return ref<long>();
 }
 
 template <>
 const char* Response::get<const char *>() const {
-	return &m_str[0];
+	return ref<Buffer>().data();
 }
 
 template <>
 bool Response::get<bool>() const {
-	return m_bool;
+	return ref<bool>();
 }
 
 template <>
 double Response::get<double>() const {
-	return m_double;
+	return ref<double>();
 }
 
 template <>
 std::vector<Buffer> Response::get<std::vector<Buffer> >() const {
-	return m_array;
+	return ref<vector<Buffer> >();
 }
 
 template <>
 string Response::get<string>() const {
 
 	std::string ret;
-	ret.insert(ret.end(), m_str.begin(), m_str.end());
+	const Buffer &s = ref<Buffer>();
+	ret.insert(ret.end(), s.begin(), s.end());
 	return ret;
 }
 
 template <>
 Buffer Response::get<Buffer>() const {
-	return m_str;
+	return ref<Buffer>();
 }
 
 template <>
 RedisMap Response::get<RedisMap>() const {
-	return m_map;
+	return ref<RedisMap>();
 }
 
 Buffer
-Response::get(Buffer key) const { // maps only
+Response::get(BufferRef key) const { // maps only
 
-	return m_map.at(key);
+	return ref<RedisMap>().at(key);
 }
 
 }
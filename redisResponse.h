@@ -2,18 +2,36 @@
 #define REDIS_RESPONSE_H
 
 #include "redisCommand.h"
-#include <map>
+#include "redisMap.h"
 #include <vector>
 #include <string>
+#include <variant>
+#include <memory>
+#include <memory_resource>
 
 typedef enum {REDIS_ERR, REDIS_LONG, REDIS_STRING, REDIS_BOOL, REDIS_INFO_MAP, REDIS_HASH,
 	REDIS_DOUBLE, REDIS_LIST, REDIS_ZSET, REDIS_QUEUED} RedisResponseType;
 
 namespace redis {
+
+/**
+ * Memory for the strings of a batch of replies, freed all at once with
+ * the last reply that uses it.
+ */
+typedef std::shared_ptr<std::pmr::monotonic_buffer_resource> Arena;
+
 class Response {
 
 public:
 	Response(RedisResponseType t);
+	Response(RedisResponseType t, const Arena &arena);
+
+	// copies are made on the heap, moves keep the arena along.
+	Response(const Response &r);
+	Response(Response &&r) = default;
+	Response &operator=(const Response &r);
+	Response &operator=(Response &&r);
+
 	bool addString(Buffer s);
 	bool addString(std::string key, std::string val);
 	bool addString(Buffer key, Buffer val);
@@ -25,20 +43,49 @@ public:
 	template <typename T> bool set(T t);
 	template <typename T> T get() const;
 
-	Buffer get(Buffer key) const;
+	/** Borrows the held value, or an empty one if T is not what is held. */
+	template <typename T> const T &ref() const {
+		if(const T *p = std::get_if<T>(&m_val)) {
+			return *p;
+		}
+		static const T empty{};
+		return empty;
+	}
+
+	/**
+	 * Moves the held value out, leaving the response empty. Values from
+	 * an arena are copied to the heap instead, to outlive it.
+	 */
+	template <typename T> T take() {
+		T ret{};
+		if(T *p = std::get_if<T>(&m_val)) {
+			if(m_arena) {
+				ret = *p;
+			} else {
+				ret = std::move(*p);
+			}
+			m_val = std::monostate();
+		}
+		return ret;
+	}
+
+	Buffer get(BufferRef key) const;
 	int size() const;
+	void reserve(size_t n);
 
 private:
 	RedisResponseType m_type;
 
-	// embeded values
-	long m_long;
-	bool m_bool;
-	double m_double;
-	Buffer m_str;
-	std::vector<Buffer> m_array;
-	std::vector<std::pair<double, Buffer> > m_zarray;
-	RedisMap m_map;
+	// where the held strings were allocated, if not on the heap. Declared
+	// first so that it is destroyed last.
+	Arena m_arena;
+
+	// only the value matching m_type is ever constructed
+	typedef std::vector<std::pair<double, Buffer> > ZList;
+	std::variant<std::monostate, long, bool, double, Buffer,
+		std::vector<Buffer>, ZList, RedisMap> m_val;
+
+	template <typename T> T &hold();
 };
 }
 
@@ -0,0 +1,139 @@
+#include "redisScan.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REDIS_SCAN_X86
+#endif
+
+namespace redis {
+
+typedef const char *(*FindFun)(const char *p, size_t sz);
+
+static const char *
+find_lf_scalar(const char *p, size_t sz) {
+	return (const char*)::memchr(p, '\n', sz);
+}
+
+#ifdef REDIS_SCAN_X86
+
+__attribute__((target("sse2")))
+static const char *
+find_lf_sse2(const char *p, size_t sz) {
+
+	const __m128i lf = _mm_set1_epi8('\n');
+	const char *end = p + sz;
+	for(; p + 16 <= end; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+		if(mask) {
+			return p + __builtin_ctz(mask);
+		}
+	}
+	return find_lf_scalar(p, end - p);
+}
+
+__attribute__((target("avx2")))
+static const char *
+find_lf_avx2(const char *p, size_t sz) {
+
+	const __m256i lf = _mm256_set1_epi8('\n');
+	const char *end = p + sz;
+	for(; p + 32 <= end; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf));
+		if(mask) {
+			return p + __builtin_ctz(mask);
+		}
+	}
+	return find_lf_sse2(p, end - p);
+}
+
+static FindFun
+resolve_find_lf() {
+
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		return find_lf_avx2;
+	}
+	if(__builtin_cpu_supports("sse2")) {
+		return find_lf_sse2;
+	}
+	return find_lf_scalar;
+}
+
+static const FindFun find_lf_impl = resolve_find_lf();
+
+#else
+
+static const FindFun find_lf_impl = find_lf_scalar;
+
+#endif
+
+/**
+ * Returns the first \n in [p, p + sz), or 0.
+ */
+const char *
+find_lf(const char *p, size_t sz) {
+	return find_lf_impl(p, sz);
+}
+
+/**
+ * Converts up to eight digits, the first one in the lowest byte of x, to
+ * their value with three multiplications.
+ */
+static inline uint64_t
+eight_digits(uint64_t x) {
+
+	x = ((x & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+	x = ((x & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+	return (uint32_t)(((x & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32);
+}
+
+/**
+ * Reads an optionally negative decimal number from p, stopping at the
+ * first non-digit or at end. Where it stopped is stored in stop. Eight
+ * digits are handled at once when that many bytes can be read.
+ */
+long
+parse_long(const char *p, const char *end, const char **stop) {
+
+	bool neg = (p < end && *p == '-');
+	p += neg;
+
+	uint64_t val = 0;
+	while(end - p >= 8) {
+		uint64_t word;
+		::memcpy(&word, p, 8);
+
+		// digits become 0..9; any other byte gets its high bit set.
+		uint64_t x = word - 0x3030303030303030ULL;
+		uint64_t bad = (x | (x + 0x7676767676767676ULL)) & 0x8080808080808080ULL;
+		int n = bad ? __builtin_ctzll(bad) >> 3 : 8;
+		if(!n) {
+			break;
+		}
+
+		// keep the n digits, as leading zeros pad the number to eight.
+		x <<= 8 * (8 - n);
+		static const uint64_t pow10[] = {1, 10, 100, 1000, 10000, 100000,
+			1000000, 10000000, 100000000};
+		val = val * pow10[n] + eight_digits(x);
+		p += n;
+		if(n < 8) {
+			break;
+		}
+	}
+	while(p < end && (unsigned char)(*p - '0') < 10) {
+		val = val * 10 + (*p++ - '0');
+	}
+
+	if(stop) {
+		*stop = p;
+	}
+	return neg ? -(long)val : (long)val;
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef REDIS_SCAN_H
+#define REDIS_SCAN_H
+
+#include <cstddef>
+
+namespace redis {
+
+/**
+ * Protocol scanning primitives: finding the \n ending a line, and reading
+ * the integer of a header such as $42\r\n. Lines are found with AVX2 or
+ * SSE2 depending on the CPU, integers eight digits at a time.
+ */
+const char *find_lf(const char *p, size_t sz);
+long parse_long(const char *p, const char *end, const char **stop = 0);
+
+}
+
+#endif /* REDIS_SCAN_H */
@@ -50,7 +50,7 @@ SortParams::store(Buffer key) {
 }
 
 Command
-SortParams::buildCommand(Buffer key) {
+SortParams::buildCommand(BufferRef key) {
 
 	Command cmd("SORT");
 	cmd << key;
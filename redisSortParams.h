@@ -14,7 +14,7 @@ public:
 	void alpha();
 	void store(Buffer key);
 
-	Command buildCommand(Buffer key);
+	Command buildCommand(BufferRef key);
 
 private:
 	Buffer m_by;
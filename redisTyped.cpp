@@ -0,0 +1,408 @@
+#include "redisTyped.h"
+#include "redis.h"
+
+using namespace std;
+namespace redis {
+
+TypedClient::TypedClient(Client &client) :
+	m_client(client)
+{
+
+}
+
+Client &
+TypedClient::client() {
+	return m_client;
+}
+
+/**
+ * Sends a command and decodes its reply. The decoder is a template
+ * argument, so it is called directly and can be inlined.
+ *
+ * A decoder that fails on anything but an error line may leave part of
+ * the reply unread, the connection is then dropped to stay in sync.
+ */
+template <typename T, bool (*decode)(Client &, T &)>
+TypedReply<T>
+TypedClient::call(Command &c) {
+
+	T value{};
+	if(!m_client.run_direct(c)) {
+		return TypedReply<T>();
+	}
+	while(m_client.m_rpos == m_client.m_rlen) {
+		if(!m_client.fill()) {
+			return TypedReply<T>();
+		}
+	}
+	char type = m_client.m_rbuf[m_client.m_rpos];
+	if(!decode(m_client, value)) {
+		if(type != '-') {
+			m_client.disconnect();
+		}
+		return TypedReply<T>();
+	}
+	return TypedReply<T>(std::move(value));
+}
+
+/**
+ * +OK or any other status line is true, errors are false.
+ */
+bool
+TypedClient::read_status(Client &c, bool &out) {
+
+	size_t sz;
+	const char *line = c.read_line(sz);
+	if(!line || line[0] != '+') {
+		return false;
+	}
+	out = true;
+	return true;
+}
+
+bool
+TypedClient::read_integer(Client &c, long &out) {
+	return c.read_header(out) == ':';
+}
+
+/**
+ * Reads :1 as true, :0 as false.
+ */
+bool
+TypedClient::read_flag(Client &c, bool &out) {
+
+	long l;
+	if(c.read_header(l) != ':' || (l != 0 && l != 1)) {
+		return false;
+	}
+	out = (l == 1);
+	return true;
+}
+
+bool
+TypedClient::read_bulk(Client &c, optional<Buffer> &out) {
+
+	Buffer b;
+	bool found;
+	if(!c.read_bulk(b, found)) {
+		return false;
+	}
+	if(found) {
+		out = std::move(b);
+	}
+	return true;
+}
+
+bool
+TypedClient::read_number(Client &c, optional<double> &out) {
+
+	double d;
+	bool found;
+	if(!c.read_bulk(d, found)) {
+		return false;
+	}
+	if(found) {
+		out = d;
+	}
+	return true;
+}
+
+/**
+ * Reads a multi-bulk reply of strings, missing elements being empty.
+ */
+bool
+TypedClient::read_list(Client &c, List &out) {
+
+	long count;
+	if(c.read_header(count) != '*') {
+		return false;
+	}
+	out.resize(count > 0 ? count : 0);
+	bool found;
+	for(long i = 0; i < count; ++i) {
+		if(!c.read_bulk(out[i], found)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Reads a multi-bulk reply of strings, telling missing elements apart.
+ */
+bool
+TypedClient::read_bulks(Client &c, vector<optional<Buffer> > &out) {
+
+	long count;
+	if(c.read_header(count) != '*') {
+		return false;
+	}
+	out.resize(count > 0 ? count : 0);
+	for(long i = 0; i < count; ++i) {
+		if(!read_bulk(c, out[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+TypedReply<bool>
+TypedClient::ping() {
+	Command cmd("PING");
+	return call<bool, read_status>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::exists(BufferRef key) {
+	Command cmd("EXISTS");
+	cmd << key;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<long>
+TypedClient::del(BufferRef key) {
+	Command cmd("DEL");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::expire(BufferRef key, long ttl) {
+	Command cmd("EXPIRE");
+	cmd << key << ttl;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<long>
+TypedClient::ttl(BufferRef key) {
+	Command cmd("TTL");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<optional<Buffer> >
+TypedClient::get(BufferRef key) {
+	Command cmd("GET");
+	cmd << key;
+	return call<optional<Buffer>, read_bulk>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::set(BufferRef key, BufferRef val) {
+	Command cmd("SET");
+	cmd << key << val;
+	return call<bool, read_status>(cmd);
+}
+
+TypedReply<vector<optional<Buffer> > >
+TypedClient::mget(const List &keys) {
+	Command cmd("MGET");
+	for(List::const_iterator i = keys.begin(); i != keys.end(); i++) {
+		cmd << *i;
+	}
+	return call<vector<optional<Buffer> >, read_bulks>(cmd);
+}
+
+TypedReply<long>
+TypedClient::incr(BufferRef key, long val) {
+	if(val > 1) {
+		Command cmd("INCRBY");
+		cmd << key << val;
+		return call<long, read_integer>(cmd);
+	}
+	Command cmd("INCR");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<long>
+TypedClient::decr(BufferRef key, long val) {
+	if(val > 1) {
+		Command cmd("DECRBY");
+		cmd << key << val;
+		return call<long, read_integer>(cmd);
+	}
+	Command cmd("DECR");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<long>
+TypedClient::append(BufferRef key, BufferRef val) {
+	Command cmd("APPEND");
+	cmd << key << val;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<long>
+TypedClient::lpush(BufferRef key, BufferRef val) {
+	Command cmd("LPUSH");
+	cmd << key << val;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<long>
+TypedClient::rpush(BufferRef key, BufferRef val) {
+	Command cmd("RPUSH");
+	cmd << key << val;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<optional<Buffer> >
+TypedClient::lpop(BufferRef key) {
+	Command cmd("LPOP");
+	cmd << key;
+	return call<optional<Buffer>, read_bulk>(cmd);
+}
+
+TypedReply<optional<Buffer> >
+TypedClient::rpop(BufferRef key) {
+	Command cmd("RPOP");
+	cmd << key;
+	return call<optional<Buffer>, read_bulk>(cmd);
+}
+
+TypedReply<long>
+TypedClient::llen(BufferRef key) {
+	Command cmd("LLEN");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<optional<Buffer> >
+TypedClient::lindex(BufferRef key, long pos) {
+	Command cmd("LINDEX");
+	cmd << key << pos;
+	return call<optional<Buffer>, read_bulk>(cmd);
+}
+
+TypedReply<List>
+TypedClient::lrange(BufferRef key, long start, long end) {
+	Command cmd("LRANGE");
+	cmd << key << start << end;
+	return call<List, read_list>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::sadd(BufferRef key, BufferRef val) {
+	Command cmd("SADD");
+	cmd << key << val;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::srem(BufferRef key, BufferRef val) {
+	Command cmd("SREM");
+	cmd << key << val;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::sismember(BufferRef key, BufferRef val) {
+	Command cmd("SISMEMBER");
+	cmd << key << val;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<long>
+TypedClient::scard(BufferRef key) {
+	Command cmd("SCARD");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<List>
+TypedClient::smembers(BufferRef key) {
+	Command cmd("SMEMBERS");
+	cmd << key;
+	return call<List, read_list>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::zadd(BufferRef key, double score, BufferRef member) {
+	Command cmd("ZADD");
+	cmd << key << score << member;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<optional<double> >
+TypedClient::zscore(BufferRef key, BufferRef member) {
+	Command cmd("ZSCORE");
+	cmd << key << member;
+	return call<optional<double>, read_number>(cmd);
+}
+
+TypedReply<long>
+TypedClient::zcard(BufferRef key) {
+	Command cmd("ZCARD");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<List>
+TypedClient::zrange(BufferRef key, long start, long end) {
+	Command cmd("ZRANGE");
+	cmd << key << start << end;
+	return call<List, read_list>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::hset(BufferRef key, BufferRef field, BufferRef val) {
+	Command cmd("HSET");
+	cmd << key << field << val;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<optional<Buffer> >
+TypedClient::hget(BufferRef key, BufferRef field) {
+	Command cmd("HGET");
+	cmd << key << field;
+	return call<optional<Buffer>, read_bulk>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::hdel(BufferRef key, BufferRef field) {
+	Command cmd("HDEL");
+	cmd << key << field;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<bool>
+TypedClient::hexists(BufferRef key, BufferRef field) {
+	Command cmd("HEXISTS");
+	cmd << key << field;
+	return call<bool, read_flag>(cmd);
+}
+
+TypedReply<long>
+TypedClient::hlen(BufferRef key) {
+	Command cmd("HLEN");
+	cmd << key;
+	return call<long, read_integer>(cmd);
+}
+
+TypedReply<List>
+TypedClient::hkeys(BufferRef key) {
+	Command cmd("HKEYS");
+	cmd << key;
+	return call<List, read_list>(cmd);
+}
+
+TypedReply<List>
+TypedClient::hvals(BufferRef key) {
+	Command cmd("HVALS");
+	cmd << key;
+	return call<List, read_list>(cmd);
+}
+
+/**
+ * Fields and values, alternating.
+ */
+TypedReply<List>
+TypedClient::hgetall(BufferRef key) {
+	Command cmd("HGETALL");
+	cmd << key;
+	return call<List, read_list>(cmd);
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef REDIS_TYPED_H
+#define REDIS_TYPED_H
+
+#include "redisCommand.h"
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace redis {
+class Client;
+
+/**
+ * A reply decoded to T, or an error if the command failed or the server
+ * sent something else than what the command returns.
+ */
+template <typename T>
+class TypedReply {
+
+public:
+	TypedReply() : m_ok(false), m_value() {}
+	explicit TypedReply(T value) : m_ok(true), m_value(std::move(value)) {}
+
+	bool ok() const { return m_ok; }
+	explicit operator bool() const { return m_ok; }
+
+	const T &value() const { return m_value; }
+	const T &operator*() const { return m_value; }
+	const T *operator->() const { return &m_value; }
+	T take() { return std::move(m_value); }
+
+private:
+	bool m_ok;
+	T m_value;
+};
+
+/**
+ * Runs commands on a blocking client and decodes their replies straight
+ * into the type each command returns, with no Response in between. The
+ * decoder is fixed at compile time for every command.
+ *
+ * Missing keys are empty optionals. Replies fail in MULTI, pipelines, the
+ * event loop and shared mode, where the Client API must be used instead.
+ */
+class TypedClient {
+
+public:
+	TypedClient(Client &client);
+
+	Client &client();
+
+	TypedReply<bool> ping();
+	TypedReply<bool> exists(BufferRef key);
+	TypedReply<long> del(BufferRef key);
+	TypedReply<bool> expire(BufferRef key, long ttl);
+	TypedReply<long> ttl(BufferRef key);
+
+	TypedReply<std::optional<Buffer> > get(BufferRef key);
+	TypedReply<bool> set(BufferRef key, BufferRef val);
+	TypedReply<std::vector<std::optional<Buffer> > > mget(const List &keys);
+	TypedReply<long> incr(BufferRef key, long val = 1);
+	TypedReply<long> decr(BufferRef key, long val = 1);
+	TypedReply<long> append(BufferRef key, BufferRef val);
+
+	TypedReply<long> lpush(BufferRef key, BufferRef val);
+	TypedReply<long> rpush(BufferRef key, BufferRef val);
+	TypedReply<std::optional<Buffer> > lpop(BufferRef key);
+	TypedReply<std::optional<Buffer> > rpop(BufferRef key);
+	TypedReply<long> llen(BufferRef key);
+	TypedReply<std::optional<Buffer> > lindex(BufferRef key, long pos);
+	TypedReply<List> lrange(BufferRef key, long start, long end);
+
+	TypedReply<bool> sadd(BufferRef key, BufferRef val);
+	TypedReply<bool> srem(BufferRef key, BufferRef val);
+	TypedReply<bool> sismember(BufferRef key, BufferRef val);
+	TypedReply<long> scard(BufferRef key);
+	TypedReply<List> smembers(BufferRef key);
+
+	TypedReply<bool> zadd(BufferRef key, double score, BufferRef member);
+	TypedReply<std::optional<double> > zscore(BufferRef key, BufferRef member);
+	TypedReply<long> zcard(BufferRef key);
+	TypedReply<List> zrange(BufferRef key, long start, long end);
+
+	TypedReply<bool> hset(BufferRef key, BufferRef field, BufferRef val);
+	TypedReply<std::optional<Buffer> > hget(BufferRef key, BufferRef field);
+	TypedReply<bool> hdel(BufferRef key, BufferRef field);
+	TypedReply<bool> hexists(BufferRef key, BufferRef field);
+	TypedReply<long> hlen(BufferRef key);
+	TypedReply<List> hkeys(BufferRef key);
+	TypedReply<List> hvals(BufferRef key);
+	TypedReply<List> hgetall(BufferRef key);
+
+private:
+	template <typename T, bool (*decode)(Client &, T &)>
+	TypedReply<T> call(Command &c);
+
+	// decoders, one per reply shape.
+	static bool read_status(Client &c, bool &out);
+	static bool read_integer(Client &c, long &out);
+	static bool read_flag(Client &c, bool &out);
+	static bool read_bulk(Client &c, std::optional<Buffer> &out);
+	static bool read_number(Client &c, std::optional<double> &out);
+	static bool read_list(Client &c, List &out);
+	static bool read_bulks(Client &c, std::vector<std::optional<Buffer> > &out);
+
+	Client &m_client;
+};
+}
+
+#endif /* REDIS_TYPED_H */
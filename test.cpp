@@ -1,9 +1,17 @@
 #include "redis.h"
+#include "redisCoroutine.h"
+#include "redisClientPool.h"
+#include "redisScan.h"
 #include <iostream>
 #include <string>
 #include <cstring>
 #include <cstdlib>
 #include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <thread>
+#include <algorithm>
 
 int tests_passed = 0;
 int tests_failed = 0;
@@ -1486,6 +1494,1178 @@ testMultiExec(redis::Client &redis) {
 	assert(ret.type() == REDIS_STRING && ret.get<string>() == "abc");
 }
 
+void
+testEventLoop() {
+
+	redis::Client c1, c2;
+	c1.connect();
+	c2.connect();
+
+	redis::EventLoop loop;
+	assert(loop.add(c1));
+	assert(loop.add(c2));
+	assert(!c1.pipeline());
+
+	// commands are queued, replies are delivered to their callbacks.
+	redis::Response ret = c1.set("async-x", "abc");
+	assert(ret.type() == REDIS_QUEUED);
+	c2.set("async-y", "def");
+
+	string x, y;
+	long last = 0;
+	c1.on_reply([&](redis::Response &r) { x = r.get<string>(); }).get("async-x");
+	c2.on_reply([&](redis::Response &r) { y = r.get<string>(); }).get("async-y");
+
+	c1.del("async-n");
+	for(int i = 0; i < 1000; ++i) {
+		c1.on_reply([&](redis::Response &r) { last = r.get<long>(); }).incr("async-n");
+	}
+	assert(loop.pending() == 1005);
+
+	loop.run();
+	assert(loop.pending() == 0);
+	assert(x == "abc");
+	assert(y == "def");
+	assert(last == 1000);
+
+	// once removed, the client is blocking again.
+	loop.remove(c1);
+	ret = c1.get("async-n");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "1000");
+
+	// the loop lets go of the socket before remove() returns.
+	bool sync = true;
+	for(int i = 0; i < 20; ++i) {
+		loop.add(c1);
+		c1.on_reply([](redis::Response &) {}).incr("async-n");
+		loop.run();
+		loop.run_once(0); // receiving again
+		loop.remove(c1);
+		sync = sync && c1.get("async-n").type() == REDIS_STRING;
+	}
+	assert(sync);
+}
+
+void
+testEventLoopClients() {
+
+	// many connections served by one loop, whichever backend it uses.
+	redis::EventLoop loop;
+	vector<redis::Client> clients(20);
+	vector<long> last(clients.size(), 0);
+
+	clients[0].connect();
+	clients[0].del("async-m");
+	for(size_t i = 0; i < clients.size(); ++i) {
+		if(i) {
+			clients[i].connect();
+		}
+		assert(loop.add(clients[i]));
+		for(int j = 0; j < 100; ++j) {
+			clients[i].on_reply([&last, i](redis::Response &r) { last[i] = r.get<long>(); }).incr("async-m");
+		}
+	}
+	assert(loop.pending() == 2000);
+
+	loop.run();
+	assert(loop.pending() == 0);
+	assert(*max_element(last.begin(), last.end()) == 2000);
+
+	// removing a client from its own callback fails the rest.
+	vector<int> types;
+	redis::Client &c = clients[0];
+	for(int j = 0; j < 3; ++j) {
+		c.on_reply([&](redis::Response &r) { types.push_back(r.type()); loop.remove(c); }).get("async-m");
+	}
+	loop.run();
+	assert(types.size() == 3 && types[0] == REDIS_STRING && types[2] == REDIS_ERR);
+	assert(c.get("async-m").get<string>() == "2000");
+}
+
+redis::Task
+coroutineHandler(redis::CoClient &cc, int id, int &done) {
+
+	stringstream s;
+	s << "co-key-" << id;
+	string key = s.str();
+
+	redis::Response ret = co_await cc.set(key.c_str(), "abc");
+	assert(ret.type() == REDIS_BOOL && ret.get<bool>());
+
+	ret = co_await cc.get(key); // borrowed, not copied
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "abc");
+
+	cc.client().del(key.c_str()); // no callback, reply dropped
+	ret = co_await cc.exists(key.c_str());
+	assert(ret.type() == REDIS_BOOL && !ret.get<bool>());
+
+	done++;
+}
+
+void
+testCoroutines() {
+
+	redis::Client c1, c2;
+	c1.connect();
+	c2.connect();
+
+	redis::EventLoop loop;
+	loop.add(c1);
+	loop.add(c2);
+	redis::CoClient cc1(c1), cc2(c2);
+
+	// handlers run until their first co_await, the loop resumes them.
+	int done = 0;
+	for(int i = 0; i < 10; ++i) {
+		coroutineHandler(i % 2 ? cc1 : cc2, i, done);
+	}
+	assert(done == 0);
+
+	// an awaiter dropped before its reply arrives: the reply is ignored.
+	(void)cc1.ping();
+
+	loop.run();
+	assert(done == 10);
+}
+
+void
+testClientPool() {
+
+	redis::ClientPool pool(3);
+	{
+		redis::ClientPool::Handle c = pool.checkout();
+		c->del("pool-n");
+		assert(pool.stats().in_use == 1);
+	}
+	assert(pool.stats().in_use == 0);
+
+	// more threads than connections.
+	vector<thread> threads;
+	for(int t = 0; t < 6; ++t) {
+		threads.push_back(thread([&pool]() {
+			for(int i = 0; i < 100; ++i) {
+				redis::ClientPool::Handle c = pool.checkout();
+				c->incr("pool-n");
+			}
+		}));
+	}
+	for(size_t t = 0; t < threads.size(); ++t) {
+		threads[t].join();
+	}
+
+	redis::ClientPool::Handle c = pool.checkout();
+	redis::Response ret = c->get("pool-n");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "600");
+
+	redis::ClientPool::Stats stats = pool.stats();
+	assert(stats.checkouts == 602 && stats.in_use == 1 && stats.size == 3);
+
+	// transactions don't outlive the checkout.
+	c->multi();
+	c->set("pool-n", "0");
+	c.release();
+	c = pool.checkout();
+	ret = c->get("pool-n");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "600");
+
+	// broken connections are replaced.
+	c->disconnect();
+	c.release();
+	c = pool.checkout();
+	assert(c->connected() && pool.stats().replaced == 1);
+
+	// a pool in the place of an older one doesn't inherit its affinity.
+	alignas(redis::ClientPool) char place[sizeof(redis::ClientPool)];
+	redis::ClientPool *big = new(place) redis::ClientPool(3);
+	{
+		redis::ClientPool::Handle h0 = big->checkout(), h1 = big->checkout(), h2 = big->checkout();
+	}
+	big->~ClientPool();
+	redis::ClientPool *small = new(place) redis::ClientPool(1);
+	{
+		redis::ClientPool::Handle h = small->checkout();
+		assert(h->connected() && small->stats().affinity_hits == 0);
+	}
+	small->~ClientPool();
+}
+
+void
+testUnixSocket(const char *path) {
+
+	redis::Client c;
+	assert(c.connect_unix(path));
+
+	redis::Response ret = c.set("unix-x", "abc");
+	assert(ret.type() == REDIS_BOOL && ret.get<bool>());
+	ret = c.get("unix-x");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "abc");
+
+	c.pipeline();
+	c.set("unix-x", "def");
+	c.get("unix-x");
+	vector<redis::Response> vret = c.exec();
+	assert(vret.size() == 2);
+	assert(vret[1].type() == REDIS_STRING && vret[1].get<string>() == "def");
+
+	// reconnects to the same socket.
+	assert(c.reconnect());
+	ret = c.get("unix-x");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "def");
+}
+
+void
+testReconnect() {
+
+	redis::Client c;
+	c.timeout(200, 1000);
+	c.retry(3, 5, 20);
+
+	// gives up after the connect timeout.
+	assert(!c.connect("10.255.255.1", 6379));
+
+	assert(c.connect());
+	c.set("reconnect-x", "abc");
+
+	// a closed connection is reopened by the next command.
+	c.disconnect();
+	assert(!c.connected());
+	redis::Response ret = c.get("reconnect-x");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "abc");
+	assert(c.connected());
+
+	assert(c.reconnect());
+	ret = c.get("reconnect-x");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "abc");
+}
+
+void
+testShared() {
+
+	redis::Client c;
+	c.connect();
+	assert(c.share());
+	assert(!c.pipeline());
+	c.del("shared-n");
+
+	// concurrent callers each get their own replies back.
+	vector<thread> threads;
+	vector<int> errors(8, 0);
+	for(int t = 0; t < 8; ++t) {
+		threads.push_back(thread([&c, &errors, t]() {
+			stringstream s;
+			s << "shared-key-" << t;
+			string key = s.str();
+			long last = 0;
+
+			for(int i = 0; i < 200; ++i) {
+				stringstream v;
+				v << i;
+				string val = v.str();
+
+				c.set(key.c_str(), val.c_str());
+				redis::Response ret = c.get(key.c_str());
+				if(ret.type() != REDIS_STRING || ret.get<string>() != val) {
+					errors[t]++;
+				}
+
+				ret = c.incr("shared-n");
+				if(ret.type() != REDIS_LONG || ret.get<long>() <= last) {
+					errors[t]++;
+				}
+				last = ret.get<long>();
+			}
+		}));
+	}
+	for(size_t t = 0; t < threads.size(); ++t) {
+		threads[t].join();
+		assert(errors[t] == 0);
+	}
+
+	redis::Response ret = c.get("shared-n");
+	assert(ret.type() == REDIS_STRING && ret.get<string>() == "1600");
+
+	redis::List keys;
+	keys.push_back("shared-key-0");
+	keys.push_back("shared-key-7");
+	ret = c.mget(keys);
+	assert(ret.type() == REDIS_HASH && ret.size() == 2);
+}
+
+void
+testReplyView() {
+
+	redis::Client c;
+	c.connect();
+	c.del("view-l");
+	c.del("view-h");
+
+	redis::ReplyView v;
+	assert(c.get(v, "view-nope") && v.type() == REDIS_ERR);
+
+	c.set("view-s", "hello");
+	assert(c.get(v, "view-s") && v.type() == REDIS_STRING && v.str() == "hello");
+
+	// large lists are read in place, across many refills of the buffer.
+	string payload(100, 'x');
+	for(int i = 0; i < 2000; ++i) {
+		c.rpush("view-l", payload.c_str());
+	}
+	c.rpush("view-l", "");
+	assert(c.lrange(v, "view-l", 0, -1) && v.type() == REDIS_LIST && v.size() == 2001);
+	assert(v[0] == payload && v[1999] == payload && v[2000].empty());
+
+	// other commands and views leave a pinned view intact.
+	redis::ReplyView h;
+	c.hset("view-h", "f1", "v1");
+	c.hset("view-h", "f2", "v2");
+	assert(c.hgetall(h, "view-h") && h.size() == 4);
+	for(int i = 0; i < 10; ++i) {
+		redis::Response ret = c.lrange("view-l", 0, -1);
+		assert(ret.size() == 2001);
+	}
+	size_t n = 0;
+	for(redis::ReplyView::const_iterator i = v.begin(); i != v.end(); i++) {
+		n += (*i == payload);
+	}
+	assert(n == 2000);
+	assert(h[0] == "f1" || h[0] == "f2");
+
+	v.release();
+	assert(v.size() == 0);
+	assert(c.smembers(v, "view-none") && v.type() == REDIS_LIST && v.size() == 0);
+}
+
+void
+testStreaming() {
+
+	redis::Client c;
+	c.connect();
+
+	string big(300000, 'b');
+	big[0] = 'a';
+	c.set("stream-big", big.c_str());
+
+	// chunks never exceed the receive buffer and add up to the value.
+	string got;
+	size_t chunks = 0, largest = 0;
+	redis::Response ret = c.get_to("stream-big", [&](const char *data, size_t sz) {
+		got.append(data, sz);
+		chunks++;
+		largest = max(largest, sz);
+		return true;
+	});
+	assert(ret.type() == REDIS_LONG && ret.get<long>() == 300000);
+	assert(got == big && chunks > 1 && largest <= 65536);
+
+	// truncated copy, and missing keys.
+	char buf[10];
+	ret = c.get_to("stream-big", buf, sizeof(buf));
+	assert(ret.type() == REDIS_LONG && ret.get<long>() == 300000);
+	assert(string(buf, 10) == big.substr(0, 10));
+	c.del("stream-none");
+	assert(c.get_to("stream-none", buf, sizeof(buf)).type() == REDIS_ERR);
+
+	// a failing sink still leaves the connection usable.
+	ret = c.get_to("stream-big", [](const char *, size_t) { return false; });
+	assert(ret.type() == REDIS_ERR);
+	assert(c.ping().type() == REDIS_BOOL);
+
+	int fds[2];
+	assert(pipe(fds) == 0);
+	c.set("stream-small", "to a pipe");
+	ret = c.get_to("stream-small", fds[1]);
+	assert(ret.type() == REDIS_LONG && ret.get<long>() == 9);
+	assert(read(fds[0], buf, sizeof(buf)) == 9 && string(buf, 9) == "to a pipe");
+	close(fds[0]);
+	close(fds[1]);
+}
+
+void
+testUploads() {
+
+	redis::Client c;
+	c.connect();
+
+	string big(200000, 'u');
+	big[199999] = 'z';
+	redis::Response ret = c.set_from("upload-mem", big.data(), big.size());
+	assert(ret.type() == REDIS_BOOL && ret.get<bool>());
+	assert(c.get("upload-mem").get<string>() == big);
+
+	// from a file, at an offset.
+	char path[] = "/tmp/redis-upload-XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd != -1);
+	assert(write(fd, big.data(), big.size()) == (ssize_t)big.size());
+	ret = c.set_from("upload-file", fd, 1000, big.size() - 1000);
+	assert(ret.type() == REDIS_BOOL && ret.get<bool>());
+	assert(c.get("upload-file").get<string>() == big.substr(1000));
+
+	ret = c.append_from("upload-file", fd, 0, 10);
+	assert(ret.type() == REDIS_LONG && ret.get<long>() == 199010);
+	ret = c.append_from("upload-file", "end", 3);
+	assert(ret.type() == REDIS_LONG && ret.get<long>() == 199013);
+	close(fd);
+	unlink(path);
+
+	// from a pipe.
+	int fds[2];
+	assert(pipe(fds) == 0);
+	assert(write(fds[1], "piped", 5) == 5);
+	ret = c.set_from("upload-pipe", fds[0], 0, 5);
+	assert(ret.type() == REDIS_BOOL && ret.get<bool>());
+	assert(c.get("upload-pipe").get<string>() == "piped");
+	close(fds[0]);
+	close(fds[1]);
+}
+
+/**
+ * Checks the replies parsed from the stream used by testParser.
+ */
+void
+checkParsed(redis::Parser &p) {
+
+	redis::Reply r;
+	assert(p.ready() == 7);
+
+	assert(p.next(r) && r.type == '+' && string(r.str.begin(), r.str.end()) == "OK");
+	assert(p.next(r) && r.type == ':' && r.integer == 42);
+	assert(p.next(r) && r.type == '$' && string(r.str.begin(), r.str.end()) == "hel\r\nlo");
+	assert(p.next(r) && r.type == '$' && r.integer == -1);
+
+	// nested multi-bulk, with empty and nil elements.
+	assert(p.next(r) && r.type == '*' && r.elements.size() == 3);
+	assert(string(r.elements[0].str.begin(), r.elements[0].str.end()) == "a");
+	assert(r.elements[1].type == '*' && r.elements[1].elements.size() == 2);
+	assert(r.elements[1].elements[0].integer == 1);
+	assert(r.elements[1].elements[1].type == '$' && r.elements[1].elements[1].str.empty());
+	assert(r.elements[2].type == '$' && r.elements[2].integer == -1);
+
+	assert(p.next(r) && r.type == '*' && r.integer == 0 && r.elements.empty());
+	assert(p.next(r) && r.type == '-' && string(r.str.begin(), r.str.end()) == "ERR bad");
+	assert(!p.next(r) && p.ready() == 0);
+}
+
+void
+testParser() {
+
+	string stream = "+OK\r\n:42\r\n$7\r\nhel\r\nlo\r\n$-1\r\n"
+		"*3\r\n$1\r\na\r\n*2\r\n:1\r\n$0\r\n\r\n$-1\r\n*0\r\n-ERR bad\r\n";
+
+	// all at once, byte by byte and in uneven chunks.
+	redis::Parser p;
+	assert(p.feed(stream.data(), stream.size()));
+	checkParsed(p);
+
+	for(size_t i = 0; i < stream.size(); ++i) {
+		assert(p.ready() == 0 || i > 4);
+		p.feed(&stream[i], 1);
+	}
+	checkParsed(p);
+
+	for(size_t i = 0, n = 1; i < stream.size(); i += n, n = n * 3 % 7 + 1) {
+		p.feed(&stream[i], min(n, stream.size() - i));
+	}
+	checkParsed(p);
+
+	// framing only: replies are counted, then dropped.
+	redis::Parser framer(false);
+	framer.feed(stream.data(), stream.size() - 3);
+	assert(framer.ready() == 6);
+	framer.feed(stream.data() + stream.size() - 3, 3);
+	assert(framer.ready() == 7);
+	while(framer.next()) {
+	}
+	assert(framer.ready() == 0);
+
+	// a huge announced bulk is not allocated up front.
+	assert(p.feed("$999999999999\r\nab", 17) && p.ready() == 0);
+	p.reset();
+
+	// garbage fails the parser until it is reset.
+	assert(!p.feed("?what\r\n", 7) && p.failed());
+	assert(!p.feed("+OK\r\n", 5) && p.ready() == 0);
+	p.reset();
+	assert(p.feed("+OK\r\n", 5) && p.ready() == 1);
+}
+
+void
+testScan() {
+
+	const char *stop;
+	string s = "123456789012\r\n";
+	assert(redis::parse_long(s.data(), s.data() + s.size(), &stop) == 123456789012L && *stop == '\r');
+
+	// short numbers, signs, and numbers cut by the end of the buffer.
+	s = "-42\r\n$5\r\n";
+	assert(redis::parse_long(s.data(), s.data() + s.size(), &stop) == -42 && stop == s.data() + 3);
+	assert(redis::parse_long(s.data(), s.data() + 2) == -4);
+	s = "0\r\n";
+	assert(redis::parse_long(s.data(), s.data() + s.size()) == 0);
+	s = "x";
+	assert(redis::parse_long(s.data(), s.data() + s.size(), &stop) == 0 && stop == s.data());
+
+	// every length, on both sides of the eight digits fast path.
+	bool ok = true;
+	long v = 0;
+	for(int digits = 1; digits <= 18; ++digits) {
+		v = v * 10 + digits % 10;
+		stringstream ss;
+		ss << v << "\r\n+OK\r\n";
+		string line = ss.str();
+		ok = ok && redis::parse_long(line.data(), line.data() + line.size()) == v;
+	}
+	assert(ok);
+
+	// \n at every position, with and without the vector loops.
+	string buf(200, 'a');
+	ok = !redis::find_lf(buf.data(), buf.size());
+	for(size_t i = 0; i < buf.size(); ++i) {
+		buf[i] = '\n';
+		ok = ok && redis::find_lf(buf.data(), buf.size()) == &buf[i];
+		ok = ok && (i < 3 || redis::find_lf(buf.data() + 3, i - 3) == 0);
+		buf[i] = 'a';
+	}
+	assert(ok);
+}
+
+void
+testNumbers() {
+
+	redis::Client c;
+	c.connect();
+	c.del("num-z");
+
+	// scores make the round trip with all their digits.
+	c.zadd("num-z", 1.2345678901234567, "a");
+	redis::Response ret = c.zscore("num-z", "a");
+	assert(ret.type() == REDIS_DOUBLE && ret.get<double>() == 1.2345678901234567);
+
+	ret = c.zincrby("num-z", 0.1, "a");
+	assert(ret.type() == REDIS_DOUBLE && ret.get<double>() == 1.2345678901234567 + 0.1);
+
+	c.zadd("num-z", -1e-300, "b");
+	assert(c.zscore("num-z", "b").get<double>() == -1e-300);
+
+	c.set("num-n", "-9223372036854775807");
+	ret = c.incr("num-n");
+	assert(ret.type() == REDIS_LONG && ret.get<long>() == -9223372036854775807L + 1);
+}
+
+void
+testCommand() {
+
+	redis::Command cmd("SET");
+	cmd << redis::Buffer("k") << 42L << 0.5;
+
+	redis::Buffer frame;
+	cmd.append_to(frame);
+	assert(string(frame.begin(), frame.end()) ==
+		"*4\r\n$3\r\nSET\r\n$1\r\nk\r\n$2\r\n42\r\n$3\r\n0.5\r\n");
+
+	// large arguments are sent from where they are.
+	redis::Buffer big(string(5000, 'v').c_str());
+	redis::Command large("APPEND");
+	large << "key" << big << "x";
+
+	struct iovec iov[3];
+	assert(large.get(iov, 1) == 3);
+	assert(large.get(iov, 3) == 3 && iov[1].iov_base == big.data() && iov[1].iov_len == 5000);
+	assert(string((char*)iov[0].iov_base, iov[0].iov_len) == "*4\r\n$6\r\nAPPEND\r\n$3\r\nkey\r\n$5000\r\n");
+	assert(string((char*)iov[2].iov_base, iov[2].iov_len) == "\r\n$1\r\nx\r\n");
+
+	// many arguments move the frame out of its inline storage.
+	redis::Command many("DEL");
+	string expected = "*201\r\n$3\r\nDEL\r\n";
+	for(int i = 0; i < 200; ++i) {
+		many << "key-xxxx";
+		expected += "$8\r\nkey-xxxx\r\n";
+	}
+	redis::Command copy(many);
+	frame.clear();
+	copy.append_to(frame);
+	assert(string(frame.begin(), frame.end()) == expected);
+}
+
+void
+testPrepared() {
+
+	redis::Client c;
+	c.connect();
+	c.del("prep-h");
+
+	redis::PreparedCommand hset("HSET");
+	hset.param() << "field";
+	hset.param();
+	assert(hset.params() == 2);
+
+	// one execution, checked against the command built by hand.
+	redis::List values;
+	values.push_back("prep-h");
+	values.push_back("v0");
+	redis::Buffer frame, expected;
+	hset.append_to(frame, values);
+	redis::Command cmd("HSET");
+	cmd << redis::Buffer("prep-h") << "field" << redis::Buffer("v0");
+	cmd.append_to(expected);
+	assert(frame == expected);
+
+	redis::Response ret = c.execute(hset, values);
+	assert(ret.type() == REDIS_LONG && ret.get<long>() == 1);
+
+	// binding too few values is refused.
+	redis::List short_values(1, "prep-h");
+	try {
+		hset.bind(short_values);
+		assert(false);
+	} catch(const std::invalid_argument &) {
+		assert(true);
+	}
+	assert(c.execute(hset, short_values).type() == REDIS_ERR);
+	assert(c.hget("prep-h", "field").get<string>() == "v0");
+
+	// a batch larger than a chunk, with a row of the wrong size.
+	vector<redis::List> batch(20000);
+	for(size_t i = 0; i < batch.size(); ++i) {
+		stringstream k, v;
+		k << "prep-" << i % 100;
+		v << "value-" << i;
+		batch[i].push_back(k.str().c_str());
+		batch[i].push_back(v.str().c_str());
+	}
+	batch[7].pop_back();
+	vector<redis::Response> all = c.execute(hset, batch);
+	assert(all.size() == 20000 && all[7].type() == REDIS_ERR);
+	assert(all[0].type() == REDIS_LONG && all[19999].type() == REDIS_LONG);
+	assert(c.hget("prep-99", "field").get<string>() == "value-19999");
+
+	// nil elements don't leave the rest of their reply to the next row.
+	redis::PreparedCommand mget("MGET");
+	mget.param();
+	mget.param();
+	c.set("prep-s", "foo");
+	vector<redis::List> rows(2);
+	rows[0].push_back("prep-missing");
+	rows[0].push_back("prep-s");
+	rows[1].push_back("prep-s");
+	rows[1].push_back("prep-s");
+	all = c.execute(mget, rows);
+	assert(all[0].type() == REDIS_LIST && all[0].size() == 2);
+	assert(all[0].ref<redis::List>()[0].empty() && all[0].ref<redis::List>()[1] == redis::Buffer("foo"));
+	assert(all[1].type() == REDIS_LIST && all[1].size() == 2);
+
+	// other reply types, and pipelines.
+	redis::PreparedCommand get("GET");
+	get.param();
+	redis::List key(1, "prep-h");
+	assert(c.pipeline());
+	c.execute(get, key);
+	c.execute(hset, batch);
+	vector<redis::Response> replies = c.exec();
+	assert(replies.size() == 20000);
+	assert(replies[0].type() == REDIS_ERR); // wrong type
+	assert(replies[1].type() == REDIS_LONG && replies[1].get<long>() == 0);
+}
+
+void
+testResponse() {
+
+	redis::Response i(REDIS_LONG);
+	i.set(42L);
+	assert(i.ref<long>() == 42 && i.ref<redis::Buffer>().empty() && i.size() == -1);
+
+	// containers are borrowed or moved out, never copied.
+	redis::Response l(REDIS_LIST);
+	l.addString("a");
+	l.addString("b");
+	const redis::List &borrowed = l.ref<redis::List>();
+	assert(borrowed.size() == 2 && &borrowed == &l.ref<redis::List>());
+	redis::List taken = l.take<redis::List>();
+	assert(taken.size() == 2 && taken[1] == redis::Buffer("b") && l.size() == 0);
+
+	redis::Response moved(std::move(i));
+	assert(moved.type() == REDIS_LONG && moved.get<long>() == 42);
+	assert(sizeof(redis::Response) < sizeof(redis::Buffer) + sizeof(redis::List) + sizeof(redis::RedisMap));
+}
+
+void
+testTyped() {
+
+	redis::Client c;
+	c.connect();
+	redis::TypedClient t(c);
+	t.del("typed-k");
+	t.del("typed-l");
+
+	assert(t.ping().ok() && *t.ping());
+
+	redis::TypedReply<optional<redis::Buffer> > v = t.get("typed-k");
+	assert(v.ok() && !v->has_value());
+	assert(*t.set("typed-k", "hello"));
+	v = t.get("typed-k");
+	assert(v.ok() && **v == redis::Buffer("hello"));
+
+	assert(t.rpush("typed-l", "a").value() == 1);
+	assert(t.rpush("typed-l", "b").value() == 2);
+	redis::TypedReply<redis::List> l = t.lrange("typed-l", 0, -1);
+	assert(l.ok() && l->size() == 2 && (*l)[1] == redis::Buffer("b"));
+
+	// replies of the wrong shape are errors, and the connection stays usable.
+	assert(!t.incr("typed-l").ok());
+	assert(!t.lrange("typed-k", 0, -1).ok());
+	assert(t.exists("typed-k").ok() && *t.exists("typed-k"));
+
+	redis::List keys;
+	keys.push_back("typed-k");
+	keys.push_back("typed-missing");
+	redis::TypedReply<vector<optional<redis::Buffer> > > all = t.mget(keys);
+	assert(all.ok() && all->size() == 2 && (*all)[0] && !(*all)[1]);
+
+	t.del("typed-z");
+	assert(*t.zadd("typed-z", 2.5, "m"));
+	assert(t.zscore("typed-z", "m")->value_or(0) == 2.5);
+	assert(t.zscore("typed-z", "nope").ok() && !t.zscore("typed-z", "nope")->has_value());
+
+	// only blocking clients can be used.
+	c.pipeline();
+	assert(!t.get("typed-k").ok());
+	c.exec();
+}
+
+void
+testBufferRef() {
+
+	redis::Client c;
+	c.connect();
+
+	// keys and values are borrowed from whatever holds them.
+	string key = "bufref-key";
+	std::string_view value("value-and-more", 5);
+	c.set(key, value);
+	assert(c.get(std::string_view(key)).get<string>() == "value");
+
+	const char bytes[] = {'b', 'u', 'f', 'r', 'e', 'f', '-', 'k', 'e', 'y'};
+	assert(c.get(std::span<const char>(bytes, sizeof(bytes))).get<string>() == "value");
+
+	// large values are still sent from where they are.
+	string big(100000, 'x');
+	c.set(key, big);
+	assert(c.get(key).get<redis::Buffer>() == redis::Buffer(big));
+
+	// short buffers are stored inline, moving long ones keeps their bytes.
+	redis::Buffer small("user:1");
+	redis::Buffer large(big.c_str());
+	const char *p = large.data();
+	redis::Buffer moved(std::move(large));
+	assert(small == redis::Buffer("user:1") && moved.data() == p);
+}
+
+void
+testArena() {
+
+	string big(1000, 'a');
+	vector<redis::Response> replies;
+	{
+		redis::Client c;
+		c.connect();
+		c.del("arena-l");
+		for(int i = 0; i < 100; ++i) {
+			c.rpush("arena-l", big);
+		}
+		c.set("arena-k", big);
+
+		assert(c.pipeline());
+		for(int i = 0; i < 50; ++i) {
+			c.get("arena-k");
+			c.lrange("arena-l", 0, -1);
+		}
+		replies = c.exec();
+
+		// a second batch has an arena of its own.
+		c.pipeline();
+		c.set("arena-k", "b");
+		c.exec();
+	}
+
+	// replies and their strings outlive the client and each other.
+	assert(replies.size() == 100);
+	assert(replies[0].ref<redis::Buffer>() == redis::Buffer(big));
+	assert(replies[99].ref<redis::List>().size() == 100);
+	redis::Response copy = replies[0];
+	redis::Response moved = std::move(replies[2]);
+	redis::List taken = replies[1].take<redis::List>();
+	replies.clear();
+	assert(copy.get<string>() == big && moved.get<string>() == big);
+	assert(taken.size() == 100 && taken[99] == redis::Buffer(big));
+}
+
+void
+testMap() {
+
+	redis::RedisMap m;
+	assert(m.insert(make_pair(redis::Buffer("a"), redis::Buffer("1"))).second);
+	pair<redis::RedisMap::iterator, bool> dup = m.insert(make_pair(redis::Buffer("a"), redis::Buffer("2")));
+	assert(!dup.second && dup.first->second == redis::Buffer("1"));
+	m["b"] = "3";
+	assert(m.size() == 2 && m.at("a") == redis::Buffer("1") && m["b"] == redis::Buffer("3"));
+	assert(m.count("c") == 0 && m.find("c") == m.end() && m.begin()->first == redis::Buffer("a"));
+
+	// entries are modified in place, in insertion order.
+	for(redis::RedisMap::iterator i = m.begin(); i != m.end(); i++) {
+		i->second += "!";
+	}
+	m.find("a")->second += "?";
+	redis::RedisMap copy;
+	copy = m;
+	assert(copy.at("a") == redis::Buffer("1!?") && (++copy.begin())->second == redis::Buffer("3!"));
+
+	// a large hash, looked up field by field.
+	redis::Client c;
+	c.connect();
+	c.del("map-h");
+	assert(c.pipeline());
+	for(int i = 0; i < 2000; ++i) {
+		string f = "field-" + to_string(i), v = "value-" + to_string(i);
+		c.hset("map-h", f, v);
+	}
+	c.exec();
+
+	redis::Response ret = c.hgetall("map-h");
+	assert(ret.type() == REDIS_HASH && ret.size() == 2000);
+	bool ok = true;
+	for(int i = 0; i < 2000; ++i) {
+		ok = ok && ret.get("field-" + to_string(i)) == redis::Buffer(("value-" + to_string(i)).c_str());
+	}
+	assert(ok);
+
+	// fields read in a pipeline stay in its arena, keys as well as values.
+	c.pipeline();
+	c.hgetall("map-h");
+	vector<redis::Response> replies = c.exec();
+	const redis::RedisMap &piped = replies[0].ref<redis::RedisMap>();
+	std::pmr::memory_resource *arena = piped.begin()->second.get_allocator().resource();
+	assert(arena != std::pmr::get_default_resource());
+	ok = true;
+	for(redis::RedisMap::const_iterator i = piped.begin(); i != piped.end(); ++i) {
+		ok = ok && i->first.get_allocator().resource() == arena;
+	}
+	assert(ok && piped.size() == 2000);
+
+	ret = c.info();
+	assert(ret.type() == REDIS_INFO_MAP && ret.get("redis_version").size() > 0);
+}
+
+void
+testWindow() {
+
+	redis::Client c, other;
+	c.connect();
+	other.connect();
+	c.del("window-n");
+	c.set("window-big", string(100000, 'w'));
+
+	// a long pipeline is sent while it is being queued.
+	c.window(100, 4096);
+	assert(c.pipeline());
+	for(int i = 0; i < 20000; ++i) {
+		c.incr("window-n");
+		if(i % 1000 == 0) {
+			c.get("window-big"); // larger than the window
+		}
+	}
+	long before = atol(other.get("window-n").get<string>().c_str());
+	assert(before > 0 && before < 20000);
+
+	vector<redis::Response> replies = c.exec();
+	assert(replies.size() == 20020);
+	bool ordered = true;
+	long n = 0;
+	for(size_t i = 0; i < replies.size(); ++i) {
+		if(replies[i].type() == REDIS_LONG) {
+			ordered = ordered && replies[i].get<long>() == ++n;
+		} else {
+			ordered = ordered && replies[i].ref<redis::Buffer>().size() == 100000;
+		}
+	}
+	assert(ordered && n == 20000);
+
+	// the client is usable again, and a window of one command works.
+	c.window(1, 1);
+	c.pipeline();
+	c.incr("window-n");
+	c.get("window-big");
+	c.incr("window-n");
+	replies = c.exec();
+	assert(replies.size() == 3 && replies[2].get<long>() == 20002);
+	assert(c.get("window-n").get<string>() == "20002");
+
+	// discarding a pipeline that was partly sent leaves no arena behind.
+	c.pipeline();
+	for(int i = 0; i < 10; ++i) {
+		c.incr("window-n");
+	}
+	c.discard();
+	redis::Response ret = c.get("window-big");
+	assert(ret.ref<redis::Buffer>().get_allocator().resource() == std::pmr::get_default_resource());
+}
+
+void
+testPipelineCallbacks() {
+
+	redis::Client c;
+	c.connect();
+	c.del("cb-n");
+	c.set("cb-k", "v");
+
+	// replies are handled while the pipeline is still being queued.
+	long sum = 0, calls = 0;
+	c.window(50, 1024);
+	assert(c.pipeline());
+	for(int i = 0; i < 1000; ++i) {
+		c.on_reply([&](redis::Response &r) { sum += r.get<long>(); calls++; }).incr("cb-n");
+	}
+	assert(calls > 0 && calls < 1000);
+
+	// dropped replies are skipped, other ones are returned in order.
+	redis::List keys;
+	keys.push_back("cb-k");
+	c.drop().mget(keys);
+	c.get("cb-k");
+	c.drop().lrange("cb-k", 0, -1); // an error, ignored
+	c.mget(keys);
+	c.drop().get("cb-k");
+	vector<redis::Response> replies = c.exec();
+	assert(calls == 1000 && sum == 1000 * 1001 / 2);
+	assert(replies.size() == 2 && replies[0].get<string>() == "v");
+	assert(replies[1].type() == REDIS_HASH && replies[1].get("cb-k") == redis::Buffer("v"));
+
+	// replies handed to callbacks are on the heap, not in the pipeline's arena.
+	bool heap = false;
+	c.pipeline();
+	c.on_reply([&](redis::Response &r) {
+		heap = r.ref<redis::Buffer>().get_allocator().resource() == std::pmr::get_default_resource();
+	}).get("cb-k");
+	c.exec();
+	assert(heap);
+
+	// callbacks may queue more commands.
+	vector<long> seen;
+	c.pipeline();
+	c.on_reply([&](redis::Response &r) {
+		seen.push_back(r.get<long>());
+		c.on_reply([&](redis::Response &r) { seen.push_back(r.get<long>()); }).incr("cb-n");
+	}).incr("cb-n");
+	replies = c.exec();
+	assert(replies.empty() && seen.size() == 2 && seen[1] == 1002);
+}
+
+void
+testMultiBatch() {
+
+	redis::Client c, other;
+	c.connect();
+	other.connect();
+	c.del("tx-n");
+	c.set("tx-k", "v");
+
+	// nothing reaches the server before exec().
+	assert(c.multi().get<bool>());
+	bool queued = true;
+	for(int i = 0; i < 100; ++i) {
+		queued = queued && c.incr("tx-n").type() == REDIS_QUEUED;
+	}
+	assert(queued);
+	redis::List keys;
+	keys.push_back("tx-k");
+	keys.push_back("tx-missing");
+	c.mget(keys);
+	c.get("tx-n");
+	assert(other.get("tx-n").type() == REDIS_ERR);
+
+	vector<redis::Response> vret = c.exec();
+	assert(vret.size() == 102);
+	assert(vret[0].get<long>() == 1 && vret[99].get<long>() == 100);
+	assert(vret[100].type() == REDIS_HASH && vret[100].size() == 1 && vret[100].get("tx-k") == redis::Buffer("v"));
+	assert(vret[101].get<string>() == "100");
+
+	// an MGET that fails, refused or not, leaves the keys of the next one.
+	c.multi();
+	c.mget(redis::List());
+	c.mget(keys);
+	vret = c.exec();
+	assert(vret.size() == 2 && vret[0].type() == REDIS_ERR);
+	assert(vret[1].type() == REDIS_HASH && vret[1].get("tx-k") == redis::Buffer("v"));
+
+	// a discarded transaction costs nothing, the client goes on as usual.
+	c.multi();
+	c.incr("tx-n");
+	assert(c.discard().get<bool>());
+	assert(c.get("tx-n").get<string>() == "100");
+}
+
+/**
+ * A transaction cut by a failed write is sent again in full on the next
+ * connection. The "server" never reads the first one, so the client's
+ * write times out halfway through.
+ */
+void
+testMultiResend() {
+
+	int ls = socket(AF_INET, SOCK_STREAM, 0);
+	int small = 4096;
+	setsockopt(ls, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	assert(bind(ls, (struct sockaddr*)&addr, len) == 0 && listen(ls, 4) == 0);
+	getsockname(ls, (struct sockaddr*)&addr, &len);
+
+	string head;
+	thread server([ls, &head]() {
+		int first = accept(ls, 0, 0);
+		int second = accept(ls, 0, 0);
+		char buf[32];
+		size_t got = 0;
+		while(got < sizeof(buf)) {
+			ssize_t n = read(second, buf + got, sizeof(buf) - got);
+			if(n <= 0) {
+				break;
+			}
+			got += n;
+		}
+		head.assign(buf, got);
+		close(first);
+		close(second);
+	});
+
+	redis::Client c;
+	c.timeout(1000, 200);
+	c.retry(1, 1, 1);
+	assert(c.connect("127.0.0.1", ntohs(addr.sin_port)));
+	c.multi();
+	c.set("resend-k", string(64 << 20, 'r'));
+	assert(c.exec().empty());
+	server.join();
+	close(ls);
+
+	assert(head.compare(0, 15, "*1\r\n$5\r\nMULTI\r\n") == 0);
+}
+
+/**
+ * Keys of the MGETs of a failed pipeline don't go to the next MGET. The
+ * "server" closes the first connection, then answers one MGET.
+ */
+void
+testPipelineFailure() {
+
+	int ls = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	assert(bind(ls, (struct sockaddr*)&addr, len) == 0 && listen(ls, 4) == 0);
+	getsockname(ls, (struct sockaddr*)&addr, &len);
+
+	thread server([ls]() {
+		char buf[256];
+		int first = accept(ls, 0, 0);
+		read(first, buf, sizeof(buf));
+		close(first);
+
+		int second = accept(ls, 0, 0);
+		string cmd;
+		while(cmd.find("fresh\r\n") == string::npos) {
+			ssize_t n = read(second, buf, sizeof(buf));
+			if(n <= 0) {
+				break;
+			}
+			cmd.append(buf, n);
+		}
+		const char reply[] = "*1\r\n$3\r\nnew\r\n";
+		write(second, reply, sizeof(reply) - 1);
+		close(second);
+	});
+
+	{
+		redis::Client c;
+		c.retry(1, 1, 1);
+		assert(c.connect("127.0.0.1", ntohs(addr.sin_port)));
+		c.pipeline();
+		c.mget(redis::List(1, "stale"));
+		vector<redis::Response> replies = c.exec();
+		assert(replies.size() == 1 && replies[0].type() == REDIS_ERR);
+
+		redis::Response ret = c.mget(redis::List(1, "fresh"));
+		assert(ret.type() == REDIS_HASH && ret.size() == 1 && ret.get("fresh") == redis::Buffer("new"));
+	}
+	server.join();
+	close(ls);
+}
+
+/**
+ * An upload from a file is sent again in full on a new connection, and
+ * leaves the caller's file position alone. The "server" never reads the
+ * first connection, then answers the whole SET on the second one.
+ */
+void
+testUploadRetry() {
+
+	int ls = socket(AF_INET, SOCK_STREAM, 0);
+	int small = 4096;
+	setsockopt(ls, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	assert(bind(ls, (struct sockaddr*)&addr, len) == 0 && listen(ls, 4) == 0);
+	getsockname(ls, (struct sockaddr*)&addr, &len);
+
+	string big(16 << 20, 'f');
+	big[big.size() - 1] = 'z';
+	char path[] = "/tmp/redis-retry-XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd != -1);
+	assert(write(fd, big.data(), big.size()) == (ssize_t)big.size());
+	lseek(fd, 7, SEEK_SET);
+
+	thread server([ls]() {
+		int first = accept(ls, 0, 0);
+		int second = accept(ls, 0, 0);
+		char buf[4096];
+		string tail;
+		while(tail.find("z\r\n") == string::npos) {
+			ssize_t n = read(second, buf, sizeof(buf));
+			if(n <= 0) {
+				break;
+			}
+			tail = tail.substr(tail.size() < 4 ? 0 : tail.size() - 4) + string(buf, n);
+		}
+		const char reply[] = "+OK\r\n";
+		write(second, reply, sizeof(reply) - 1);
+		close(first);
+		close(second);
+	});
+
+	{
+		redis::Client c;
+		c.timeout(1000, 200);
+		c.retry(1, 1, 1);
+		assert(c.connect("127.0.0.1", ntohs(addr.sin_port)));
+		redis::Response ret = c.set_from("retry-k", fd, 0, big.size());
+		assert(ret.type() == REDIS_BOOL && ret.get<bool>());
+	}
+	server.join();
+	close(ls);
+
+	assert(lseek(fd, 0, SEEK_CUR) == 7);
+	close(fd);
+	unlink(path);
+}
+
 int main() {
 
 	redis::Client r;
@@ -1536,6 +2716,32 @@ int main() {
 //	testLastsave(r);
 
 	testMultiExec(r);
+	testEventLoop();
+	testEventLoopClients();
+	testCoroutines();
+	testClientPool();
+	testReconnect();
+	testShared();
+	testReplyView();
+	testStreaming();
+	testUploads();
+	testParser();
+	testScan();
+	testNumbers();
+	testCommand();
+	testPrepared();
+	testResponse();
+	testTyped();
+	testBufferRef();
+	testArena();
+	testMap();
+	testWindow();
+	testPipelineCallbacks();
+	testMultiBatch();
+	testMultiResend();
+	testPipelineFailure();
+	testUploadRetry();
+//	testUnixSocket("/tmp/redis.sock"); // needs "unixsocket /tmp/redis.sock" in redis.conf.
 
 
 	cout << endl << tests_passed << " tests passed, " << tests_failed << " failed." << endl;